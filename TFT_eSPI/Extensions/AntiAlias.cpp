@@ -0,0 +1,247 @@
+/***************************************************************************************
+** Anti-aliased shapes. Each shape is convex and knows its signed distance (negative
+** inside) and, for any row, the span of pixels within a distance d of its edge. Pixel
+** centres are at integer coordinates and a pixel is covered by 0.5 - distance, so a
+** row only has partial coverage between the spans at d = +0.5 and d = -0.5. The
+** distance is evaluated there, the pixels in between are filled with one solid span.
+***************************************************************************************/
+
+// Convex hull of 2 circles: a wedge, or a capsule (line with round ends) if the radii are equal
+struct aa_wedge_t {
+	float ax, ay, ar, bx, by, br;
+
+	aa_wedge_t(float ax, float ay, float ar, float bx, float by, float br)
+		: ax(ax), ay(ay), ar(ar), bx(bx), by(by), br(br) {}
+
+	float top()    const { return std::min(ay - ar, by - br); }
+	float bottom() const { return std::max(ay + ar, by + br); }
+
+	// The larger circle if it contains the other one
+	bool contained(float &cx, float &cy, float &r, float d) const {
+		float dx = bx - ax, dy = by - ay;
+		float rd = ar - br;
+		if (rd * rd < dx * dx + dy * dy) return false;
+		if (ar >= br) { cx = ax; cy = ay; r = ar + d; }
+		else          { cx = bx; cy = by; r = br + d; }
+		return true;
+	}
+
+	float distance(float px, float py) const {
+		float cx, cy, r;
+		if (contained(cx, cy, r, 0)) return hypotf(px - cx, py - cy) - r;
+
+		// Position along and across the axis, in units of the axis length squared
+		float dx = bx - ax, dy = by - ay;
+		float h  = dx * dx + dy * dy;
+		px -= ax; py -= ay;
+		float qx = fabsf(px * dy - py * dx) / h;
+		float qy = (px * dx + py * dy) / h;
+
+		// Direction of the tangent lines
+		float rd = ar - br;
+		float cx2 = sqrtf(h - rd * rd);
+		float k = cx2 * qy - rd * qx;
+
+		if (k < 0)   return sqrtf(h * (qx * qx + qy * qy)) - ar;
+		if (k > cx2) return sqrtf(h * (qx * qx + qy * qy + 1.0f - 2.0f * qy)) - br;
+		return cx2 * qx + rd * qy - ar;
+	}
+
+	// Span of the shape grown by d on row y, false if the row misses it
+	bool span(float y, float d, float &xl, float &xr) const {
+		float ra = ar + d, rb = br + d;
+
+		// A circle shrunk to nothing is dropped, the span stays inside the shape
+		if (ra < 0 && rb < 0) return false;
+
+		float cx, cy, r;
+		if (ra < 0 || rb < 0 || contained(cx, cy, r, d)) {
+			if (ra < 0)      { cx = bx; cy = by; r = rb; }
+			else if (rb < 0) { cx = ax; cy = ay; r = ra; }
+			return circleSpan(cx, cy, r, y, xl, xr);
+		}
+
+		xl =  INFINITY;
+		xr = -INFINITY;
+		float l, h;
+		if (circleSpan(ax, ay, ra, y, l, h)) { xl = l; xr = h; }
+		if (circleSpan(bx, by, rb, y, l, h)) { xl = std::min(xl, l); xr = std::max(xr, h); }
+
+		// The band between the outer tangents, a quadrilateral of the 4 tangent points
+		float dx = bx - ax, dy = by - ay;
+		float len = sqrtf(dx * dx + dy * dy);
+		float ux = dx / len, uy = dy / len;
+		float s = (ra - rb) / len, c = sqrtf(1.0f - s * s);
+
+		float px[4], py[4];
+		for (int i = 0; i < 2; i++) {
+			float sign = i ? -1.0f : 1.0f;
+			float mx = ux * s - uy * c * sign, my = uy * s + ux * c * sign;
+			px[i * 3] = ax + ra * mx; py[i * 3] = ay + ra * my;
+			px[1 + i] = bx + rb * mx; py[1 + i] = by + rb * my;
+		}
+		for (int i = 0; i < 4; i++) {
+			int j = (i + 1) & 3;
+			float y0 = std::min(py[i], py[j]), y1 = std::max(py[i], py[j]);
+			if (y < y0 || y > y1 || y0 == y1) continue;
+			float x = px[i] + (px[j] - px[i]) * (y - py[i]) / (py[j] - py[i]);
+			xl = std::min(xl, x);
+			xr = std::max(xr, x);
+		}
+
+		return xl <= xr;
+	}
+
+	static bool circleSpan(float cx, float cy, float r, float y, float &xl, float &xr) {
+		float dy = y - cy;
+		float q = r * r - dy * dy;
+		if (q < 0) return false;
+		q = sqrtf(q);
+		xl = cx - q;
+		xr = cx + q;
+		return true;
+	}
+};
+
+// Rectangle with round corners, hx and hy are the half sizes of the rectangle between the corner centres
+struct aa_round_rect_t {
+	float cx, cy, hx, hy, r;
+
+	aa_round_rect_t(float cx, float cy, float hx, float hy, float r)
+		: cx(cx), cy(cy), hx(hx), hy(hy), r(r) {}
+
+	float top()    const { return cy - hy - r; }
+	float bottom() const { return cy + hy + r; }
+
+	float distance(float px, float py) const {
+		float qx = fabsf(px - cx) - hx, qy = fabsf(py - cy) - hy;
+		float ox = std::max(qx, 0.0f), oy = std::max(qy, 0.0f);
+		return sqrtf(ox * ox + oy * oy) + std::min(std::max(qx, qy), 0.0f) - r;
+	}
+
+	bool span(float y, float d, float &xl, float &xr) const {
+		// Shrunk beyond the corner radius the corners are square
+		float rr = r + d, ex = hx, ey = hy;
+		if (rr < 0) { ex += rr; ey += rr; rr = 0; }
+		if (ex < 0 || ey < 0) return false;
+
+		float dy = std::max(fabsf(y - cy) - ey, 0.0f);
+		if (dy > rr) return false;
+		float half = ex + sqrtf(rr * rr - dy * dy);
+		xl = cx - half;
+		xr = cx + half;
+		return true;
+	}
+};
+
+template <typename T> void TFT_eSPI::fillSmoothShape(const T &shape, uint32_t color, uint32_t bg_color)
+{
+	if (_vpOoB) return;
+
+	// Rows and columns in the viewport, relative to the datum
+	int32_t vx0 = _vpX - _xDatum, vx1 = _vpW - _xDatum - 1;
+	int32_t vy0 = _vpY - _yDatum, vy1 = _vpH - _yDatum - 1;
+
+	int32_t y0 = (int32_t)std::max<float>(vy0, ceilf(shape.top() - 0.5f));
+	int32_t y1 = (int32_t)std::min<float>(vy1, floorf(shape.bottom() + 0.5f));
+
+	uint8_t alpha[128];
+
+	for (int32_t y = y0; y <= y1; y++) {
+		float ol, or_, il, ir;
+		if (!shape.span(y, 0.5f, ol, or_)) continue;
+
+		int32_t xo0 = (int32_t)std::max<float>(vx0, ceilf(ol));
+		int32_t xo1 = (int32_t)std::min<float>(vx1, floorf(or_));
+		if (xo0 > xo1) continue;
+
+		// Pixels covered completely, an empty span if there are none
+		int32_t xi0 = xo1 + 1, xi1 = xo1;
+		if (shape.span(y, -0.5f, il, ir)) {
+			xi0 = (int32_t)std::max<float>(xo0, ceilf(il));
+			xi1 = (int32_t)std::min<float>(xo1, floorf(ir));
+			if (xi0 > xi1) { xi0 = xo1 + 1; xi1 = xo1; }
+		}
+
+		// Edge bands left and right of the solid span
+		for (int side = 0; side < 2; side++) {
+			int32_t x  = side ? xi1 + 1 : xo0;
+			int32_t xe = side ? xo1 : xi0 - 1;
+			while (x <= xe) {
+				uint32_t n = std::min<uint32_t>(xe - x + 1, sizeof(alpha));
+				for (uint32_t i = 0; i < n; i++) {
+					float cover = 0.5f - shape.distance(x + i, y);
+					alpha[i] = cover <= 0 ? 0 : cover >= 1 ? 255 : (uint8_t)(cover * 255 + 0.5f);
+				}
+				drawCoverage(x, y, n, alpha, color, bg_color);
+				x += n;
+			}
+		}
+
+		if (xi0 <= xi1) drawFastHLine(xi0, y, xi1 - xi0 + 1, color);
+	}
+}
+
+/***************************************************************************************
+** TFT_eSPI anti-aliased drawing functions
+***************************************************************************************/
+
+uint16_t TFT_eSPI::drawPixel(int32_t x, int32_t y, uint32_t color, uint8_t alpha, uint32_t bg_color)
+{
+	if (bg_color == 0x00FFFFFF) bg_color = readPixel(x, y);
+	color = alphaBlend(alpha, color, bg_color);
+	drawPixel(x, y, color);
+	return color;
+}
+
+void TFT_eSPI::drawSpot(float ax, float ay, float r, uint32_t fg_color, uint32_t bg_color)
+{
+	BUS_PRIMITIVE("drawSpot");
+
+	fillSmoothShape(aa_wedge_t(ax, ay, r, ax, ay, r), fg_color, bg_color);
+	autoPresent();
+}
+
+// The edge is half a pixel outside the outer pixel centres, like fillCircle() the circle is 2 * r + 1 wide
+void TFT_eSPI::fillSmoothCircle(int32_t x, int32_t y, int32_t r, uint32_t color, uint32_t bg_color)
+{
+	if (r <= 0) return;
+
+	BUS_PRIMITIVE("fillSmoothCircle");
+
+	fillSmoothShape(aa_wedge_t(x, y, r + 0.5f, x, y, r + 0.5f), color, bg_color);
+	autoPresent();
+}
+
+void TFT_eSPI::fillSmoothRoundRect(int32_t x, int32_t y, int32_t w, int32_t h, int32_t radius, uint32_t color, uint32_t bg_color)
+{
+	if (w <= 0 || h <= 0) return;
+
+	BUS_PRIMITIVE("fillSmoothRoundRect");
+
+	if (radius < 0) radius = 0;
+	if (2 * radius > w) radius = w / 2;
+	if (2 * radius > h) radius = h / 2;
+
+	// The straight edges are on pixel boundaries, only the corners are anti-aliased
+	fillSmoothShape(aa_round_rect_t(x + (w - 1) * 0.5f, y + (h - 1) * 0.5f, w * 0.5f - radius, h * 0.5f - radius, radius),
+						 color, bg_color);
+	autoPresent();
+}
+
+void TFT_eSPI::drawWideLine(float ax, float ay, float bx, float by, float wd, uint32_t fg_color, uint32_t bg_color)
+{
+	BUS_PRIMITIVE("drawWideLine");
+
+	drawWedgeLine(ax, ay, bx, by, wd, wd, fg_color, bg_color);
+}
+
+void TFT_eSPI::drawWedgeLine(float ax, float ay, float bx, float by, float aw, float bw, uint32_t fg_color, uint32_t bg_color)
+{
+	BUS_PRIMITIVE("drawWedgeLine");
+
+	if (aw < 0 || bw < 0) return;
+
+	fillSmoothShape(aa_wedge_t(ax, ay, aw / 2.0f, bx, by, bw / 2.0f), fg_color, bg_color);
+	autoPresent();
+}
@@ -0,0 +1,190 @@
+/***************************************************************************************
+** Code for the bus cost model, see BusCost.h
+***************************************************************************************/
+
+// The bus clock follows the Arduino clock, so it also runs virtual or fast forward
+static uint64_t busNow()
+{
+	return clockMicros() * 1000;
+}
+
+// Bytes of the commands sent by setWindow(): CASET + 4, PASET + 4, RAMWR
+void TFT_eSPI::busWindow()
+{
+	_busCall.windows++;
+	_busCall.cmdBytes  += 3;
+	_busCall.dataBytes += 8;
+
+	addr_row = 0xFFFF;
+	addr_col = 0xFFFF;
+}
+
+// drawPixel() only sends a column or row address that differs from the last pixel
+void TFT_eSPI::busPixel(int32_t x, int32_t y)
+{
+	if (addr_col != x) { _busCall.cmdBytes++; _busCall.dataBytes += 4; addr_col = x; }
+	if (addr_row != y) { _busCall.cmdBytes++; _busCall.dataBytes += 4; addr_row = y; }
+	_busCall.cmdBytes++;
+	_busCall.pixelBytes += 2;
+}
+
+void TFT_eSPI::busEnd()
+{
+	const char *name = _busPrimitive;
+	_busPrimitive = nullptr;
+
+	// Sprites have no bus
+	if (!_fb) return;
+
+	_busCall.calls = 1;
+
+	_busFrame.calls      += _busCall.calls;
+	_busFrame.windows    += _busCall.windows;
+	_busFrame.cmdBytes   += _busCall.cmdBytes;
+	_busFrame.dataBytes  += _busCall.dataBytes;
+	_busFrame.pixelBytes += _busCall.pixelBytes;
+
+	busAdd(_busPrimitives, _busPrimitiveCount, name, _busCall);
+	if (_busSite) busAdd(_busSites, _busSiteCount, _busSite, _busCall);
+
+	if (_busThrottle && !_busAsync) busAdvance(busTimePs(_busCall) / 1000);
+
+	_busCall = {};
+	_busAsync = false;
+}
+
+void TFT_eSPI::busAdvance(uint64_t ns)
+{
+	// The bus was idle since the last call
+	uint64_t now = busNow();
+	if (_busClock < now) _busClock = now;
+	_busClock += ns;
+
+	// Like the panel scanning out its memory the display shows the frame buffer once per refresh
+	if (_busClock >= _busTick) {
+		busWait();
+		submitFrame();
+		_busTick = _busClock - _busClock % _busPeriod + _busPeriod;
+	}
+}
+
+void TFT_eSPI::busWait()
+{
+	clockWaitUntil((_busClock + 999) / 1000);
+}
+
+void TFT_eSPI::setBusThrottle(bool enable, uint16_t hz)
+{
+	_busThrottle = enable;
+	if (hz > 0) _busPeriod = 1000000000 / hz;
+	_busClock = busNow();
+	_busTick = _busClock + _busPeriod;
+}
+
+bool TFT_eSPI::getBusThrottle()
+{
+	return _busThrottle;
+}
+
+void TFT_eSPI::busFrame()
+{
+	// Bytes sent outside of an accounted drawing call
+	if (_busCall.windows || _busCall.cmdBytes || _busCall.pixelBytes) {
+		_busPrimitive = "other";
+		busEnd();
+	}
+
+	if (!_busFrame.calls) return;
+
+	uint32_t time = busTime(_busFrame);
+	_busLastFrame = _busFrame;
+	_busFrames++;
+	_busTotalTime += time;
+	if (time > _busWorstFrame) _busWorstFrame = time;
+
+	_busFrame = {};
+}
+
+// Add a cost to the entry of a name
+void TFT_eSPI::busAdd(bus_entry_t *table, uint8_t &count, const char *name, const bus_cost_t &cost)
+{
+	uint8_t i = 0;
+	while (i < count && table[i].name != name && strcmp(table[i].name, name)) i++;
+
+	if (i == TFT_BUS_ENTRIES) i--; // Full, the last entry collects all further names
+	else if (i == count) {
+		count++;
+		table[i].name = count == TFT_BUS_ENTRIES ? "other" : name;
+		table[i].cost = {};
+	}
+
+	bus_cost_t &c = table[i].cost;
+	c.calls      += cost.calls;
+	c.windows    += cost.windows;
+	c.cmdBytes   += cost.cmdBytes;
+	c.dataBytes  += cost.dataBytes;
+	c.pixelBytes += cost.pixelBytes;
+}
+
+void TFT_eSPI::setBusSite(const char *site)
+{
+	_busSite = site;
+}
+
+TFT_eSPI::bus_cost_t TFT_eSPI::getBusFrameCost()
+{
+	return _busLastFrame;
+}
+
+uint32_t TFT_eSPI::getBusFrameTime()
+{
+	return busTime(_busLastFrame);
+}
+
+uint32_t TFT_eSPI::busTime(const bus_cost_t &cost)
+{
+	return (uint32_t)(busTimePs(cost) / 1000000);
+}
+
+uint64_t TFT_eSPI::busTimePs(const bus_cost_t &cost)
+{
+	return (cost.cmdBytes + cost.dataBytes + cost.pixelBytes) * (uint64_t)TFT_BUS_BYTE_PS
+			 + cost.cmdBytes * (uint64_t)TFT_BUS_CMD_NS * 1000;
+}
+
+void TFT_eSPI::resetBusStats()
+{
+	_busCall = {};
+	_busFrame = {};
+	_busLastFrame = {};
+	_busFrames = 0;
+	_busWorstFrame = 0;
+	_busTotalTime = 0;
+	_busPrimitiveCount = 0;
+	_busSiteCount = 0;
+}
+
+void TFT_eSPI::busPrint(Print &out, const char *title, const bus_entry_t *table, uint8_t count)
+{
+	out.printf("%-18s %8s %8s %12s %12s %12s\n", title, "calls", "windows", "cmd+param", "pixel bytes", "time us");
+	for (uint8_t i = 0; i < count; i++) {
+		const bus_cost_t &c = table[i].cost;
+		out.printf("%-18s %8lu %8lu %12llu %12llu %12lu\n", table[i].name, (unsigned long)c.calls, (unsigned long)c.windows,
+					  (unsigned long long)(c.cmdBytes + c.dataBytes), (unsigned long long)c.pixelBytes, (unsigned long)busTime(c));
+	}
+}
+
+void TFT_eSPI::printBusReport(Print &out)
+{
+#if defined (TFT_PARALLEL_8_BIT) || defined (TFT_PARALLEL_16_BIT)
+	out.printf("TFT bus: parallel, %d ns write cycle\n", TFT_WRITE_CYCLE_NS);
+#else
+	out.printf("TFT bus: SPI, %lu Hz\n", (unsigned long)SPI_FREQUENCY);
+#endif
+	out.printf("Frames: %lu, last %lu us, worst %lu us, average %lu us\n", (unsigned long)_busFrames,
+				  (unsigned long)getBusFrameTime(), (unsigned long)_busWorstFrame,
+				  (unsigned long)(_busFrames ? _busTotalTime / _busFrames : 0));
+
+	busPrint(out, "Primitive", _busPrimitives, _busPrimitiveCount);
+	if (_busSiteCount) busPrint(out, "Call site", _busSites, _busSiteCount);
+}
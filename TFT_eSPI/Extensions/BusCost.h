@@ -0,0 +1,82 @@
+ // Bus cost model, estimates how long the drawing calls keep the TFT interface busy on
+ // the device. Command, parameter and pixel bytes are counted the way the TFT_eSPI drivers
+ // send them and are converted to time with SPI_FREQUENCY (or the parallel write cycle).
+ // A frame ends with each present(), costs are kept per frame, per primitive and per call site.
+ // With the bus throttle the sketch runs on a virtual bus clock instead: drawing calls return
+ // at once and advance the clock, and at each refresh of the virtual scanout the sketch waits
+ // for the bus and the display shows the frame buffer. Frames fill at the speed of the device,
+ // so partially drawn frames, tearing and latency look like on the hardware.
+
+ public:
+
+  typedef struct {
+    uint32_t calls;      // Drawing calls made by the sketch
+    uint32_t windows;    // Address windows set (CASET, PASET and RAMWR commands)
+    uint64_t cmdBytes;   // Command bytes
+    uint64_t dataBytes;  // Command parameter bytes
+    uint64_t pixelBytes; // Pixel data bytes
+  } bus_cost_t;
+
+           // Account the following drawing calls to a named call site, nullptr for none
+           // The name must stay valid until resetBusStats(), e.g. a string literal
+  void     setBusSite(const char *site);
+
+           // Cost and estimated device time in microseconds of the last frame
+  bus_cost_t getBusFrameCost(void);
+  uint32_t getBusFrameTime(void);
+
+           // Estimated device time of a cost in microseconds
+  uint32_t busTime(const bus_cost_t &cost);
+
+           // Print the costs per frame, per primitive and per call site since the last reset
+  void     printBusReport(Print &out = Serial);
+  void     resetBusStats(void);
+
+           // Run drawing at the speed of the bus, the display is refreshed hz times per second
+  void     setBusThrottle(bool enable, uint16_t hz = 60);
+  bool     getBusThrottle(void);
+
+ protected:
+
+  typedef struct {
+    const char *name;
+    bus_cost_t cost;
+  } bus_entry_t;
+
+           // Outermost drawing call of the sketch, nested calls are accounted to it
+  struct bus_scope_t {
+    TFT_eSPI *tft;
+    bool     outer;
+    bus_scope_t(TFT_eSPI *t, const char *name) : tft(t), outer(!t->_busPrimitive) { if (outer) t->_busPrimitive = name; }
+    ~bus_scope_t() { if (outer) tft->busEnd(); }
+  };
+
+           // Bytes sent by the drivers
+  void     busWindow(void);                   // setWindow()
+  void     busPixel(int32_t x, int32_t y);    // drawPixel(), only changed coordinates are sent
+  void     busPixels(uint32_t len) { _busCall.pixelBytes += 2 * len; }
+  void     busRead(uint32_t len) { _busCall.pixelBytes += 1 + 3 * len; } // Dummy byte and RGB666 pixels, RAMRD replaces RAMWR
+
+  void     busEnd(void);                      // End of a drawing call
+  uint64_t busTimePs(const bus_cost_t &cost);
+  void     busAdvance(uint64_t ns);           // Advance the virtual bus clock, refresh on ticks
+  void     busWait(void);                     // Wait until the bus clock has passed
+  void     busFrame(void);                    // End of a frame
+  void     busAdd(bus_entry_t *table, uint8_t &count, const char *name, const bus_cost_t &cost);
+  void     busPrint(Print &out, const char *title, const bus_entry_t *table, uint8_t count);
+
+  const char *_busPrimitive;          // Name of the drawing call in progress
+  const char *_busSite;               // Call site set by setBusSite()
+  bus_cost_t _busCall;                // Cost of the drawing call in progress
+  bus_cost_t _busFrame, _busLastFrame;
+  uint32_t _busFrames, _busWorstFrame;
+  uint64_t _busTotalTime;
+
+  bool     _busAsync;                 // The call in progress is a DMA transfer, the sketch does not wait for it
+  bool     _busThrottle;
+  uint64_t _busClock;                 // Virtual bus clock, Arduino clock time in ns
+  uint64_t _busTick, _busPeriod;      // Next refresh of the virtual scanout and refresh period in ns
+
+  bus_entry_t _busPrimitives[TFT_BUS_ENTRIES];
+  bus_entry_t _busSites[TFT_BUS_ENTRIES];
+  uint8_t  _busPrimitiveCount, _busSiteCount;
@@ -0,0 +1,474 @@
+/***************************************************************************************
+** Batch colour conversion and alpha blending. Each function processes whole buffers with
+** the widest kernel the CPU supports: AVX2 (chosen at run time), SSE2 (x86-64 baseline) or
+** the scalar code, which also handles the pixels left over by the vector loops.
+** Byte shuffles of 3 byte pixels need AVX2 (or at least SSSE3), those have no SSE2 kernel.
+***************************************************************************************/
+
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+  #include <immintrin.h>
+  #define TFT_COLOR_AVX2 __attribute__((target("avx2")))
+
+static bool cpuHasAVX2()
+{
+	static const bool avx2 = __builtin_cpu_supports("avx2");
+	return avx2;
+}
+#endif
+
+// The 256 8 bit colours, in both byte orders
+struct color332_lut_t {
+	uint16_t color[256], swapped[256];
+	constexpr color332_lut_t() : color(), swapped() {
+		for (uint32_t i = 0; i < 256; i++) {
+			color[i]   = TFT_eSPI::color8to16((uint8_t)i);
+			swapped[i] = color[i] >> 8 | color[i] << 8;
+		}
+	}
+};
+static constexpr color332_lut_t color332Lut;
+
+// Alpha 0 to 255 as a weight of 0 to 256, so that 255 gives the foreground colour exactly
+static inline int32_t blendWeight(uint8_t alpha)
+{
+	return alpha + (alpha >> 7);
+}
+
+// Each channel is bg + floor((fg - bg) * weight / 256), like the vector kernels compute it
+static inline uint32_t blendChannel(uint32_t fg, uint32_t bg, int32_t weight)
+{
+	return bg + ((((int32_t)fg - (int32_t)bg) * weight) >> 8);
+}
+
+static inline uint16_t blend565(uint8_t alpha, uint16_t fgc, uint16_t bgc)
+{
+	int32_t w = blendWeight(alpha);
+	return blendChannel(fgc >> 11, bgc >> 11, w) << 11
+		  | blendChannel((fgc >> 5) & 0x3F, (bgc >> 5) & 0x3F, w) << 5
+		  | blendChannel(fgc & 0x1F, bgc & 0x1F, w);
+}
+
+// Randomise alpha by +/- dither, like the dither of alphaBlend()
+static inline uint8_t ditherAlpha(uint8_t alpha, uint8_t dither)
+{
+	int16_t alphaDither = (int16_t)alpha - dither + random(2 * dither + 1);
+	if (alphaDither < 0) return 0;
+	if (alphaDither > 255) return 255;
+	return (uint8_t)alphaDither;
+}
+
+/***************************************************************************************
+** Vector kernels, they return the number of pixels converted
+***************************************************************************************/
+
+#ifdef TFT_COLOR_AVX2
+TFT_COLOR_AVX2 static uint32_t swap565AVX2(const uint16_t *in, uint16_t *out, uint32_t len)
+{
+	uint32_t i = 0;
+	for (; i + 16 <= len; i += 16) {
+		__m256i c = _mm256_loadu_si256((const __m256i *)(in + i));
+		c = _mm256_or_si256(_mm256_slli_epi16(c, 8), _mm256_srli_epi16(c, 8));
+		_mm256_storeu_si256((__m256i *)(out + i), c);
+	}
+	return i;
+}
+
+// 8 pixels per step, each 128 bit lane holds 4 of them (12 bytes). The 16 byte loads read up
+// to 4 bytes past the 24 bytes converted, so the loop stops 2 pixels before the end.
+TFT_COLOR_AVX2 static uint32_t color888to565AVX2(const uint8_t *rgb, uint16_t *out, uint32_t len, bool swap)
+{
+	// Red and green as 16 bit values in the low and high half of each lane, blue in the low half
+	const __m256i rg = _mm256_setr_epi8(0, -1, 3, -1, 6, -1, 9, -1, 1, -1, 4, -1, 7, -1, 10, -1,
+													0, -1, 3, -1, 6, -1, 9, -1, 1, -1, 4, -1, 7, -1, 10, -1);
+	const __m256i bl = _mm256_setr_epi8(2, -1, 5, -1, 8, -1, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+													2, -1, 5, -1, 8, -1, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m256i maskR = _mm256_set1_epi16(0xF8), maskG = _mm256_set1_epi16(0xFC);
+
+	uint32_t i = 0;
+	for (; i + 10 <= len; i += 8) {
+		__m128i lo = _mm_loadu_si128((const __m128i *)(rgb + 3 * i));
+		__m128i hi = _mm_loadu_si128((const __m128i *)(rgb + 3 * i + 12));
+		__m256i v  = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+
+		__m256i c = _mm256_shuffle_epi8(v, rg);
+		__m256i r = _mm256_slli_epi16(_mm256_and_si256(c, maskR), 8);
+		__m256i g = _mm256_slli_epi16(_mm256_and_si256(_mm256_srli_si256(c, 8), maskG), 3);
+		__m256i b = _mm256_srli_epi16(_mm256_shuffle_epi8(v, bl), 3);
+		__m256i p = _mm256_or_si256(_mm256_or_si256(r, g), b);
+		if (swap) p = _mm256_or_si256(_mm256_slli_epi16(p, 8), _mm256_srli_epi16(p, 8));
+
+		// The results are in the low half of each lane
+		p = _mm256_permute4x64_epi64(p, 0x08);
+		_mm_storeu_si128((__m128i *)(out + i), _mm256_castsi256_si128(p));
+	}
+	return i;
+}
+
+TFT_COLOR_AVX2 static uint32_t color565to888AVX2(const uint16_t *in, uint8_t *rgb, uint32_t len)
+{
+	// Interleave R0..R7 G0..G7 and B0..B7 into 24 bytes of R, G, B
+	const __m128i rg0 = _mm_setr_epi8(0, 8, -1, 1, 9, -1, 2, 10, -1, 3, 11, -1, 4, 12, -1, 5);
+	const __m128i b0  = _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1);
+	const __m128i rg1 = _mm_setr_epi8(13, -1, 6, 14, -1, 7, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i b1  = _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i mask6 = _mm_set1_epi16(0x3F), mask5 = _mm_set1_epi16(0x1F);
+
+	uint32_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		__m128i c = _mm_loadu_si128((const __m128i *)(in + i));
+		__m128i r = _mm_srli_epi16(c, 11);
+		__m128i g = _mm_and_si128(_mm_srli_epi16(c, 5), mask6);
+		__m128i b = _mm_and_si128(c, mask5);
+
+		// The low bits repeat the high bits, so white stays 0xFF
+		r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+		g = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+		b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+
+		__m128i cg = _mm_packus_epi16(r, g);
+		__m128i cb = _mm_packus_epi16(b, b);
+		__m128i out0 = _mm_or_si128(_mm_shuffle_epi8(cg, rg0), _mm_shuffle_epi8(cb, b0));
+		__m128i out1 = _mm_or_si128(_mm_shuffle_epi8(cg, rg1), _mm_shuffle_epi8(cb, b1));
+		_mm_storeu_si128((__m128i *)(rgb + 3 * i), out0);
+		_mm_storel_epi64((__m128i *)(rgb + 3 * i + 16), out1);
+	}
+	return i;
+}
+
+// 16 pixels per step, each 565 channel is blended in 16 bit lanes like blend565() does it
+TFT_COLOR_AVX2 static uint32_t alphaBlendAVX2(const uint8_t *alpha, const uint16_t *fg, uint16_t fgc,
+                                             const uint16_t *bg, uint16_t *out, uint32_t len)
+{
+	const __m256i mask6 = _mm256_set1_epi16(0x3F), mask5 = _mm256_set1_epi16(0x1F);
+
+	uint32_t i = 0;
+	for (; i + 16 <= len; i += 16) {
+		__m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(alpha + i)));
+		a = _mm256_add_epi16(a, _mm256_srli_epi16(a, 7));
+		__m256i f = fg ? _mm256_loadu_si256((const __m256i *)(fg + i)) : _mm256_set1_epi16(fgc);
+		__m256i b = _mm256_loadu_si256((const __m256i *)(bg + i));
+
+		__m256i rf = _mm256_srli_epi16(f, 11), rb = _mm256_srli_epi16(b, 11);
+		__m256i gf = _mm256_and_si256(_mm256_srli_epi16(f, 5), mask6), gb = _mm256_and_si256(_mm256_srli_epi16(b, 5), mask6);
+		__m256i bf = _mm256_and_si256(f, mask5), bb = _mm256_and_si256(b, mask5);
+
+		__m256i r = _mm256_add_epi16(rb, _mm256_srai_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(rf, rb), a), 8));
+		__m256i g = _mm256_add_epi16(gb, _mm256_srai_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(gf, gb), a), 8));
+		__m256i c = _mm256_add_epi16(bb, _mm256_srai_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(bf, bb), a), 8));
+
+		c = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi16(r, 11), _mm256_slli_epi16(g, 5)), c);
+		_mm256_storeu_si256((__m256i *)(out + i), c);
+	}
+	return i;
+}
+#endif
+
+#ifdef __SSE2__
+static uint32_t swap565SSE2(const uint16_t *in, uint16_t *out, uint32_t len)
+{
+	uint32_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		__m128i c = _mm_loadu_si128((const __m128i *)(in + i));
+		c = _mm_or_si128(_mm_slli_epi16(c, 8), _mm_srli_epi16(c, 8));
+		_mm_storeu_si128((__m128i *)(out + i), c);
+	}
+	return i;
+}
+
+static uint32_t color565to332SSE2(const uint16_t *in, uint8_t *out, uint32_t len, bool swapped)
+{
+	const __m128i maskR = _mm_set1_epi16(0xE0), maskG = _mm_set1_epi16(0x1C), maskB = _mm_set1_epi16(0x03);
+
+	uint32_t i = 0;
+	for (; i + 16 <= len; i += 16) {
+		__m128i c[2];
+		for (int k = 0; k < 2; k++) {
+			__m128i v = _mm_loadu_si128((const __m128i *)(in + i + 8 * k));
+			if (swapped) v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+			c[k] = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 8), maskR),
+														_mm_and_si128(_mm_srli_epi16(v, 6), maskG)),
+									  _mm_and_si128(_mm_srli_epi16(v, 3), maskB));
+		}
+		_mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(c[0], c[1]));
+	}
+	return i;
+}
+
+static uint32_t alphaBlendSSE2(const uint8_t *alpha, const uint16_t *fg, uint16_t fgc,
+                               const uint16_t *bg, uint16_t *out, uint32_t len)
+{
+	const __m128i mask6 = _mm_set1_epi16(0x3F), mask5 = _mm_set1_epi16(0x1F), zero = _mm_setzero_si128();
+
+	uint32_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		__m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(alpha + i)), zero);
+		a = _mm_add_epi16(a, _mm_srli_epi16(a, 7));
+		__m128i f = fg ? _mm_loadu_si128((const __m128i *)(fg + i)) : _mm_set1_epi16(fgc);
+		__m128i b = _mm_loadu_si128((const __m128i *)(bg + i));
+
+		__m128i rf = _mm_srli_epi16(f, 11), rb = _mm_srli_epi16(b, 11);
+		__m128i gf = _mm_and_si128(_mm_srli_epi16(f, 5), mask6), gb = _mm_and_si128(_mm_srli_epi16(b, 5), mask6);
+		__m128i bf = _mm_and_si128(f, mask5), bb = _mm_and_si128(b, mask5);
+
+		__m128i r = _mm_add_epi16(rb, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(rf, rb), a), 8));
+		__m128i g = _mm_add_epi16(gb, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(gf, gb), a), 8));
+		__m128i c = _mm_add_epi16(bb, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(bf, bb), a), 8));
+
+		c = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, 11), _mm_slli_epi16(g, 5)), c);
+		_mm_storeu_si128((__m128i *)(out + i), c);
+	}
+	return i;
+}
+
+// 8 pixels per step, the 16.16 fixed point channels of pixels i to i + 3 and i + 4 to i + 7 are in
+// 2 registers per channel. v holds the channel values of the first pixel, off the 4 rounding offsets.
+static uint32_t interpolate565SSE2(const int32_t *v, const int32_t *step, const int32_t *off, uint16_t *out, uint32_t len)
+{
+	const __m128i offs = _mm_loadu_si128((const __m128i *)off);
+	__m128i c[3][2], inc[3];
+	for (int k = 0; k < 3; k++) {
+		__m128i base = _mm_add_epi32(_mm_set1_epi32(v[k]), _mm_setr_epi32(0, step[k], 2 * step[k], 3 * step[k]));
+		c[k][0] = _mm_add_epi32(base, offs);
+		c[k][1] = _mm_add_epi32(c[k][0], _mm_set1_epi32(4 * step[k]));
+		inc[k]  = _mm_set1_epi32(8 * step[k]);
+	}
+
+	uint32_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		__m128i p[3];
+		for (int k = 0; k < 3; k++) {
+			p[k] = _mm_packs_epi32(_mm_srai_epi32(c[k][0], 16), _mm_srai_epi32(c[k][1], 16));
+			c[k][0] = _mm_add_epi32(c[k][0], inc[k]);
+			c[k][1] = _mm_add_epi32(c[k][1], inc[k]);
+		}
+		__m128i px = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(p[0], 11), _mm_slli_epi16(p[1], 5)), p[2]);
+		_mm_storeu_si128((__m128i *)(out + i), px);
+	}
+	return i;
+}
+#endif
+
+/***************************************************************************************
+** TFT_eSPI batch conversion functions
+***************************************************************************************/
+
+void TFT_eSPI::swap565(const uint16_t *in, uint16_t *out, uint32_t len)
+{
+	uint32_t i = 0;
+#ifdef TFT_COLOR_AVX2
+	if (cpuHasAVX2()) i = swap565AVX2(in, out, len);
+#endif
+#ifdef __SSE2__
+	i += swap565SSE2(in + i, out + i, len - i);
+#endif
+	for (; i < len; i++) out[i] = in[i] >> 8 | in[i] << 8;
+}
+
+void TFT_eSPI::color888to565(const uint8_t *rgb, uint16_t *color, uint32_t len, bool swap)
+{
+	uint32_t i = 0;
+#ifdef TFT_COLOR_AVX2
+	if (cpuHasAVX2()) i = color888to565AVX2(rgb, color, len, swap);
+#endif
+	for (; i < len; i++) {
+		uint16_t c = color565(rgb[3 * i], rgb[3 * i + 1], rgb[3 * i + 2]);
+		color[i] = swap ? (uint16_t)(c >> 8 | c << 8) : c;
+	}
+}
+
+void TFT_eSPI::color565to888(const uint16_t *color, uint8_t *rgb, uint32_t len)
+{
+	uint32_t i = 0;
+#ifdef TFT_COLOR_AVX2
+	if (cpuHasAVX2()) i = color565to888AVX2(color, rgb, len);
+#endif
+	for (; i < len; i++) {
+		uint32_t c = color16to24(color[i]);
+		rgb[3 * i]     = (uint8_t)(c >> 16);
+		rgb[3 * i + 1] = (uint8_t)(c >> 8);
+		rgb[3 * i + 2] = (uint8_t)c;
+	}
+}
+
+// A table lookup per pixel, vector units without a gather instruction gain nothing here
+void TFT_eSPI::color332to565(const uint8_t *color332, uint16_t *color, uint32_t len, bool swap)
+{
+	const uint16_t *lut = swap ? color332Lut.swapped : color332Lut.color;
+	for (uint32_t i = 0; i < len; i++) color[i] = lut[color332[i]];
+}
+
+void TFT_eSPI::color565to332(const uint16_t *color, uint8_t *color332, uint32_t len, bool swapped)
+{
+	uint32_t i = 0;
+#ifdef __SSE2__
+	i = color565to332SSE2(color, color332, len, swapped);
+#endif
+	for (; i < len; i++) {
+		uint16_t c = swapped ? (uint16_t)(color[i] >> 8 | color[i] << 8) : color[i];
+		color332[i] = color16to8(c);
+	}
+}
+
+/***************************************************************************************
+** TFT_eSPI alpha blending functions
+***************************************************************************************/
+
+uint16_t TFT_eSPI::alphaBlend(uint8_t alpha, uint16_t fgc, uint16_t bgc)
+{
+	return blend565(alpha, fgc, bgc);
+}
+
+uint16_t TFT_eSPI::alphaBlend(uint8_t alpha, uint16_t fgc, uint16_t bgc, uint8_t dither)
+{
+	if (dither) alpha = ditherAlpha(alpha, dither);
+	return blend565(alpha, fgc, bgc);
+}
+
+uint32_t TFT_eSPI::alphaBlend24(uint8_t alpha, uint32_t fgc, uint32_t bgc, uint8_t dither)
+{
+	if (dither) alpha = ditherAlpha(alpha, dither);
+
+	int32_t w = blendWeight(alpha);
+	return blendChannel((fgc >> 16) & 0xFF, (bgc >> 16) & 0xFF, w) << 16
+		  | blendChannel((fgc >> 8) & 0xFF, (bgc >> 8) & 0xFF, w) << 8
+		  | blendChannel(fgc & 0xFF, bgc & 0xFF, w);
+}
+
+static void alphaBlendSpan(const uint8_t *alpha, const uint16_t *fg, uint16_t fgc,
+                           const uint16_t *bg, uint16_t *out, uint32_t len)
+{
+	uint32_t i = 0;
+#ifdef TFT_COLOR_AVX2
+	if (cpuHasAVX2()) i = alphaBlendAVX2(alpha, fg, fgc, bg, out, len);
+#endif
+#ifdef __SSE2__
+	i += alphaBlendSSE2(alpha + i, fg ? fg + i : nullptr, fgc, bg + i, out + i, len - i);
+#endif
+	for (; i < len; i++) out[i] = blend565(alpha[i], fg ? fg[i] : fgc, bg[i]);
+}
+
+// The alpha values are dithered into a small buffer that the kernels then blend.
+// Fully transparent and opaque pixels are kept, the edges of a coverage mask stay put.
+static void alphaBlendDither(const uint8_t *alpha, const uint16_t *fg, uint16_t fgc,
+                             const uint16_t *bg, uint16_t *out, uint32_t len, uint8_t dither)
+{
+	uint8_t buf[64];
+	for (uint32_t i = 0; i < len; i += sizeof(buf)) {
+		uint32_t n = std::min<uint32_t>(len - i, sizeof(buf));
+		for (uint32_t k = 0; k < n; k++) {
+			uint8_t a = alpha[i + k];
+			buf[k] = (a == 0 || a == 255) ? a : ditherAlpha(a, dither);
+		}
+		alphaBlendSpan(buf, fg ? fg + i : nullptr, fgc, bg + i, out + i, n);
+	}
+}
+
+void TFT_eSPI::alphaBlendRow(const uint8_t *alpha, const uint16_t *fg, const uint16_t *bg, uint16_t *out, uint32_t len, uint8_t dither)
+{
+	if (dither) alphaBlendDither(alpha, fg, 0, bg, out, len, dither);
+	else        alphaBlendSpan(alpha, fg, 0, bg, out, len);
+}
+
+void TFT_eSPI::alphaBlendMask(const uint8_t *alpha, uint16_t fgc, const uint16_t *bg, uint16_t *out, uint32_t len, uint8_t dither)
+{
+	if (dither) alphaBlendDither(alpha, nullptr, fgc, bg, out, len, dither);
+	else        alphaBlendSpan(alpha, nullptr, fgc, bg, out, len);
+}
+
+/***************************************************************************************
+** Gradients
+***************************************************************************************/
+
+// 4 x 4 ordered dither thresholds
+static const uint8_t bayer4x4[4][4] = {
+	{  0,  8,  2, 10 },
+	{ 12,  4, 14,  6 },
+	{  3, 11,  1,  9 },
+	{ 15,  7, 13,  5 }
+};
+
+// Colours at positions pos to pos + len - 1 of a gradient from color1 at position 0 to color2 at
+// position last. The channels are interpolated in 16.16 fixed point and rounded, or with a dither
+// row of the pixel at x0 and the next ones, dithered.
+static void interpolate565(uint16_t color1, uint16_t color2, uint32_t last, uint32_t pos, uint16_t *out, uint32_t len,
+                           const uint8_t *dither = nullptr, int32_t x0 = 0)
+{
+	const int32_t c1[3] = { color1 >> 11, (color1 >> 5) & 0x3F, color1 & 0x1F };
+	const int32_t c2[3] = { color2 >> 11, (color2 >> 5) & 0x3F, color2 & 0x1F };
+
+	int32_t v[3], step[3], off[4];
+	for (int k = 0; k < 3; k++) {
+		step[k] = last ? (c2[k] - c1[k]) * 65536 / (int32_t)last : 0;
+		v[k] = c1[k] * 65536 + (int32_t)((int64_t)step[k] * pos);
+	}
+	for (int j = 0; j < 4; j++) off[j] = dither ? dither[(x0 + j) & 3] * 4096 + 2048 : 0x8000;
+
+	uint32_t i = 0;
+#ifdef __SSE2__
+	i = interpolate565SSE2(v, step, off, out, len);
+#endif
+	for (; i < len; i++) {
+		int32_t o = off[i & 3];
+		out[i] = (uint16_t)(((v[0] + (int32_t)i * step[0] + o) >> 16) << 11
+								| ((v[1] + (int32_t)i * step[1] + o) >> 16) << 5
+								|  ((v[2] + (int32_t)i * step[2] + o) >> 16));
+	}
+}
+
+// The gradient runs over the whole rectangle, only the part in the viewport is drawn
+void TFT_eSPI::fillRectVGradient(int16_t x, int16_t y, int16_t w, int16_t h, uint32_t color1, uint32_t color2, bool dither)
+{
+	if (_vpOoB || (w < 1) || (h < 1)) return;
+
+	BUS_PRIMITIVE("fillRectVGradient");
+
+	int32_t ys = std::max<int32_t>(y, _vpY - _yDatum), ye = std::min<int32_t>(y + h, _vpH - _yDatum);
+	int32_t xs = std::max<int32_t>(x, _vpX - _xDatum), xe = std::min<int32_t>(x + w, _vpW - _xDatum);
+	if (ys >= ye || xs >= xe) return;
+
+	// Without dithering a row is one colour, dithered rows repeat a pattern of 4
+	std::vector<uint16_t> row(dither ? xe - xs : 0);
+	for (int32_t yp = ys; yp < ye; yp++) {
+		if (!dither) {
+			uint16_t color;
+			interpolate565(color1, color2, h - 1, yp - y, &color, 1);
+			drawFastHLine(xs, yp, xe - xs, color);
+			continue;
+		}
+
+		uint16_t pattern[4];
+		for (int32_t j = 0; j < 4; j++)
+			interpolate565(color1, color2, h - 1, yp - y, pattern + j, 1, bayer4x4[(yp + _yDatum) & 3], xs + _xDatum + j);
+		for (int32_t i = 0; i < xe - xs; i++) row[i] = pattern[i & 3];
+		pushRow(xs, yp, xe - xs, row.data());
+	}
+
+	autoPresent();
+}
+
+void TFT_eSPI::fillRectHGradient(int16_t x, int16_t y, int16_t w, int16_t h, uint32_t color1, uint32_t color2, bool dither)
+{
+	if (_vpOoB || (w < 1) || (h < 1)) return;
+
+	BUS_PRIMITIVE("fillRectHGradient");
+
+	int32_t ys = std::max<int32_t>(y, _vpY - _yDatum), ye = std::min<int32_t>(y + h, _vpH - _yDatum);
+	int32_t xs = std::max<int32_t>(x, _vpX - _xDatum), xe = std::min<int32_t>(x + w, _vpW - _xDatum);
+	if (ys >= ye || xs >= xe) return;
+
+	// One row, or one row per dither pattern row, is copied down the rectangle
+	int32_t n = xe - xs, rows = dither ? std::min<int32_t>(4, ye - ys) : 1;
+	std::vector<uint16_t> buf(n * rows);
+	for (int32_t r = 0; r < rows; r++)
+		interpolate565(color1, color2, w - 1, xs - x, buf.data() + r * n, n,
+							dither ? bayer4x4[(ys + r + _yDatum) & 3] : nullptr, xs + _xDatum);
+
+	for (int32_t yp = ys; yp < ye; yp++)
+		pushRow(xs, yp, n, buf.data() + ((yp - ys) % rows) * n);
+
+	autoPresent();
+}
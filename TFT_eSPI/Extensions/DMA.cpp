@@ -0,0 +1,260 @@
+/***************************************************************************************
+** Code for the DMA engine emulation, see DMA.h
+***************************************************************************************/
+
+TFT_eDMA::TFT_eDMA(dma_stats_t &stats) : _stats(stats)
+{
+	_quit   = false;
+	_active = false;
+	_src    = nullptr;
+	_len    = 0;
+	_hash   = 0;
+	_done   = 0;
+
+	_thread = std::thread(&TFT_eDMA::run, this);
+}
+
+TFT_eDMA::~TFT_eDMA(void)
+{
+	// The sketch may have freed the source already, it is not checked again
+	sync();
+	_active = false;
+
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+		_quit = true;
+	}
+	_cond.notify_all();
+	_thread.join();
+}
+
+void TFT_eDMA::run(void)
+{
+	std::unique_lock<std::mutex> guard(_lock);
+	while (true) {
+		_cond.wait(guard, [this] { return _quit || _copy; });
+		if (_quit) return;
+
+		// The sketch goes on while the pixels are copied
+		guard.unlock();
+		_copy();
+		guard.lock();
+
+		_copy = nullptr;
+		_cond.notify_all();
+	}
+}
+
+void TFT_eDMA::start(const uint16_t *src, uint32_t len, uint64_t duration, std::function<void()> copy)
+{
+	wait();
+
+	_active = true;
+	_src    = src;
+	_len    = len;
+	_hash   = hash(src, len);
+	_done   = clockMicros() + duration;
+
+	_stats.transfers++;
+	_stats.busTime += duration;
+
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+		_copy = std::move(copy);
+	}
+	_cond.notify_all();
+}
+
+bool TFT_eDMA::busy(void)
+{
+	if (!_active) return false;
+
+	uint64_t now = clockMicros();
+	if (now >= _done) {
+		sync();
+		finish();
+		return false;
+	}
+
+	// A polling loop takes time on the device, the virtual clock would never get there
+	if (getClockMode() == CLOCK_VIRTUAL) clockWaitUntil(now + 1);
+	return true;
+}
+
+void TFT_eDMA::wait(void)
+{
+	if (!_active) return;
+
+	uint64_t start = clockMicros();
+	sync();
+	clockWaitUntil(_done);
+	_stats.waitTime += clockMicros() - start;
+
+	finish();
+}
+
+void TFT_eDMA::sync(void)
+{
+	std::unique_lock<std::mutex> guard(_lock);
+	_cond.wait(guard, [this] { return !_copy; });
+}
+
+void TFT_eDMA::finish(void)
+{
+	_active = false;
+
+	// The pixels sent may be a mix of the old and the new content
+	if (hash(_src, _len) != _hash) {
+		_stats.races++;
+		std::cerr << "TFT_eSPI: DMA source buffer " << _src << " was modified during the transfer" << std::endl;
+	}
+}
+
+uint64_t TFT_eDMA::hash(const uint16_t *data, uint32_t len)
+{
+	// Every step is invertible, so any single changed word changes the hash
+	uint64_t h = len;
+	uint32_t i = 0;
+	for (; i + 4 <= len; i += 4) {
+		uint64_t w;
+		memcpy(&w, data + i, sizeof(w));
+		h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+		h ^= h >> 29;
+	}
+	for (; i < len; i++) {
+		h = (h ^ data[i]) * 0x9E3779B97F4A7C15ULL;
+		h ^= h >> 29;
+	}
+	return h;
+}
+
+/***************************************************************************************
+** TFT_eSPI DMA functions
+***************************************************************************************/
+
+bool TFT_eSPI::initDMA(bool ctrl_cs)
+{
+	// The frame buffer is allocated by init(), a chip select line does not exist
+	if (!_fb) return false;
+
+	if (!_dma) _dma = new TFT_eDMA(_dmaStats);
+	DMA_Enabled = true;
+	return true;
+}
+
+void TFT_eSPI::deInitDMA()
+{
+	delete _dma;
+	_dma = nullptr;
+	DMA_Enabled = false;
+}
+
+void TFT_eSPI::pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t* image, uint16_t* buffer)
+{
+	if ((w == 0) || (h == 0) || (!DMA_Enabled)) return;
+
+	BUS_PRIMITIVE("pushImageDMA");
+
+	PI_CLIP;
+
+	uint32_t len = dw * dh;
+
+	// Without a buffer the image itself is prepared, so it must not be in flight
+	if (buffer == nullptr) {
+		buffer = image;
+		dmaWait();
+	}
+
+	// The DMA sends the buffer as it is, so it is brought into TFT byte order (high byte first)
+	// If the image is clipped, copy the pixels into a contiguous block
+	if ((dw != w) || (dh != h)) {
+		for (int32_t yb = 0; yb < dh; yb++) {
+			const uint16_t *src = image + dx + w * (yb + dy);
+			uint16_t *dst = buffer + yb * dw;
+			if (_swapBytes)
+				swap565(src, dst, dw);
+			else
+				memmove(dst, src, dw * sizeof(uint16_t));
+		}
+	}
+	// Else, if a buffer pointer has been provided copy the whole image to the buffer
+	else if (buffer != image || _swapBytes) {
+		if (_swapBytes)
+			swap565(image, buffer, len);
+		else
+			memcpy(buffer, image, len * sizeof(uint16_t));
+	}
+
+	dmaWait();
+	setWindow(x, y, x + dw - 1, y + dh - 1);
+	dmaTransfer(buffer, len);
+}
+
+void TFT_eSPI::pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t const* image)
+{
+	if ((w == 0) || (h == 0) || (!DMA_Enabled)) return;
+
+	BUS_PRIMITIVE("pushImageDMA");
+
+	// The image can be neither clipped nor swapped, pixels outside the screen are dropped
+	dmaWait();
+	setWindow(x, y, x + w - 1, y + h - 1);
+	dmaTransfer(image, w * h);
+}
+
+void TFT_eSPI::pushPixelsDMA(uint16_t* image, uint32_t len)
+{
+	if ((len == 0) || (!DMA_Enabled)) return;
+
+	BUS_PRIMITIVE("pushPixelsDMA");
+
+	dmaWait();
+	if (_swapBytes) swap565(image, image, len);
+
+	dmaTransfer(image, len);
+}
+
+bool TFT_eSPI::dmaBusy(void)
+{
+	return _dma && _dma->busy();
+}
+
+void TFT_eSPI::dmaWait(void)
+{
+	if (_dma) _dma->wait();
+}
+
+// Send len pixels in TFT byte order to the address window, the frame buffer is written by the DMA engine
+void TFT_eSPI::dmaTransfer(const uint16_t *data, uint32_t len)
+{
+	// The window commands are sent by the processor, only the pixels go by DMA
+	bus_cost_t cost = {};
+	cost.pixelBytes = 2 * len;
+	busPixels(len);
+	_busAsync = true;
+
+	fb_rect_t win = { win_xs, win_ys, win_xe + 1, win_ye + 1 };
+	int32_t x = win_x, y = win_y;
+	fb_rect_t area = advanceWindow(len);
+
+	uint16_t *fb = _fb;
+	int32_t width = _width, height = _height;
+	_dma->start(data, len, (busTimePs(cost) + 999999) / 1000000, [=] {
+		writeRows(fb, width, height, win, x, y, data, 0, len, true);
+	});
+
+	// The damage is known now, present() waits for the pixels
+	if (area.x0 < area.x1) addDamage(area.x0, area.y0, area.x1 - area.x0, area.y1 - area.y0);
+
+	autoPresent();
+}
+
+dma_stats_t TFT_eSPI::getDMAStats()
+{
+	return _dmaStats;
+}
+
+void TFT_eSPI::resetDMAStats()
+{
+	_dmaStats = {};
+}
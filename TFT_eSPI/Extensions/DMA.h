@@ -0,0 +1,54 @@
+/***************************************************************************************
+// The DMA engine emulates the ESP32 and STM32 DMA transfers to the TFT on the host.
+// A worker thread copies the pixels of a transfer into the frame buffer while the
+// sketch goes on, and the transfer only completes when the bus would have sent all
+// pixels (timed with the bus cost model on the Arduino clock), so rendering the next
+// buffer overlaps the transfer of the previous one like on the device. Drawing calls
+// that write the frame buffer wait for the transfer first, as they wait for the bus.
+// The source buffer must not change until the transfer is over. A hash of the source
+// is taken when the transfer starts and compared again before dmaWait() returns,
+// dmaBusy() reports it done or the next transfer starts, so a sketch that modifies
+// a buffer in flight is caught. Transfers, races and the time the sketch spent waiting
+// are counted in dma_stats_t, see TFT_eSPI::getDMAStats().
+***************************************************************************************/
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+class TFT_eDMA {
+
+ public:
+
+  TFT_eDMA(dma_stats_t &stats);
+  ~TFT_eDMA(void);
+
+           // Start a transfer of len pixels from src, copy writes them to the frame buffer
+           // on the worker thread. Waits for the transfer in progress first.
+  void     start(const uint16_t *src, uint32_t len, uint64_t duration, std::function<void()> copy);
+
+  bool     busy(void);     // Transfer in progress
+  void     wait(void);     // Wait until the transfer is over
+  void     sync(void);     // Wait until the pixels are in the frame buffer, the bus may still be busy
+
+ private:
+
+  void     run(void);      // Worker thread
+  void     finish(void);   // End of the transfer, check the source
+  static uint64_t hash(const uint16_t *data, uint32_t len);
+
+  std::thread _thread;
+  std::mutex _lock;                // Guards _copy and _quit
+  std::condition_variable _cond;
+  std::function<void()> _copy;     // Copy of the transfer in progress, empty once done
+  bool     _quit;
+
+                                   // Transfer in progress (sketch thread only)
+  bool     _active;
+  const uint16_t *_src;
+  uint32_t _len;
+  uint64_t _hash;                  // Hash of the source when the transfer started
+  uint64_t _done;                  // Arduino clock time the bus has sent the last pixel (us)
+
+  dma_stats_t &_stats;
+};
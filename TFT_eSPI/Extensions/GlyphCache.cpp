@@ -0,0 +1,416 @@
+/***************************************************************************************
+** Glyph cache for the bitmap font (Font 2) and the RLE fonts (Fonts 4, 6, 7 and 8).
+** A glyph is decoded once per font, character and text size into the spans of its
+** foreground and, for text with a background colour, background pixels. Drawing a
+** cached glyph is a few span fills. The cache is shared by the TFT and all sprites,
+** it is emptied when it grows beyond TFT_GLYPH_CACHE_BYTES.
+** The bit packed glyphs of a free font are unpacked into an atlas of spans for the
+** whole font when it is first drawn, text sizes scale the spans as they are drawn.
+** drawString() keeps the strings it renders in a least recently used cache of text
+** runs. A string is rendered once into the spans it would draw, which are resolved
+** into the foreground spans and the background spans under them, a repeated string
+** is drawn with a drawSpans() call per colour. The colours are applied as the run is drawn, so a
+** string drawn again in other colours is still found in the cache.
+** Displays draw from different threads, so the caches are only used under
+** glyphCacheLock. The entries are shared pointers, an entry is drawn without the lock
+** from a reference that keeps it alive when it is evicted meanwhile.
+***************************************************************************************/
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+typedef struct {
+	int32_t width;                 // Advance in pixels, scaled by the text size
+	std::vector<fb_span_t> fg, bg; // Spans relative to the top left corner of the glyph
+} glyph_entry_t;
+
+static std::mutex glyphCacheLock;
+static std::unordered_map<uint32_t, std::shared_ptr<const glyph_entry_t>> glyphCache;
+static size_t glyphCacheBytes = 0;
+
+// Decode a glyph into one byte per pixel, 1 for the foreground
+static void decodeGlyph(uint8_t font, uint16_t index, int32_t width, int32_t height, std::vector<uint8_t> &pixels)
+{
+	pixels.assign(width * height, 0);
+
+#if defined(LOAD_FONT2) || defined(LOAD_RLE)
+	const uint8_t *table = (const uint8_t *)pgm_read_ptr(&fontdata[font].chartbl);
+	const uint8_t *data = (const uint8_t *)pgm_read_ptr(table + index * sizeof(void *));
+#endif
+
+#ifdef LOAD_FONT2
+	if (font == 2) {
+		int32_t bytes = (width + 6) / 8; // The width includes a blank column, rows are padded to bytes
+		for (int32_t y = 0; y < height; y++)
+			for (int32_t x = 0; x < width && x < bytes * 8; x++)
+				pixels[y * width + x] = (pgm_read_byte(data + y * bytes + (x >> 3)) >> (7 - (x & 7))) & 1;
+		return;
+	}
+#endif
+
+#ifdef LOAD_RLE
+	// Runs of (n & 0x7F) + 1 pixels, foreground if bit 7 is set, that wrap from row to row
+	int32_t pc = 0, len = width * height;
+	while (pc < len) {
+		uint8_t n = pgm_read_byte(data++);
+		int32_t run = std::min<int32_t>((n & 0x7F) + 1, len - pc);
+		if (n & 0x80) memset(pixels.data() + pc, 1, run);
+		pc += run;
+	}
+#endif
+}
+
+// Runs of each pixel row become textsize rows of spans
+static void buildGlyph(const std::vector<uint8_t> &pixels, int32_t width, int32_t height, uint8_t size, glyph_entry_t &g)
+{
+	for (int32_t y = 0; y < height; y++) {
+		const uint8_t *row = pixels.data() + y * width;
+		for (int32_t x = 0; x < width; ) {
+			int32_t x1 = x;
+			while ((x1 < width) && (row[x1] == row[x])) x1++;
+			std::vector<fb_span_t> &spans = row[x] ? g.fg : g.bg;
+			for (int32_t r = 0; r < size; r++) spans.push_back({ x * size, x1 * size - 1, y * size + r });
+			x = x1;
+		}
+	}
+}
+
+#ifdef LOAD_GFXFF
+typedef struct {
+	std::vector<fb_span_t> spans; // Foreground spans of all glyphs relative to the cursor
+	std::vector<uint32_t>  first; // First span of each glyph, the end of the last glyph follows
+} free_font_atlas_t;
+
+static std::unordered_map<const GFXfont *, std::shared_ptr<const free_font_atlas_t>> freeFontAtlas;
+
+// Glyph bitmaps are rows of width bits, packed without padding from the bitmap offset
+static void buildAtlas(const GFXfont *gfx, free_font_atlas_t &atlas)
+{
+	const uint8_t  *bitmap = (const uint8_t *)pgm_read_ptr(&gfx->bitmap);
+	const GFXglyph *glyphs = (const GFXglyph *)pgm_read_ptr(&gfx->glyph);
+	uint16_t count = pgm_read_word(&gfx->last) - pgm_read_word(&gfx->first) + 1;
+
+	for (uint16_t c = 0; c < count; c++) {
+		atlas.first.push_back(atlas.spans.size());
+
+		uint32_t bo = pgm_read_dword(&glyphs[c].bitmapOffset);
+		int32_t  w  = pgm_read_byte(&glyphs[c].width),
+				 h  = pgm_read_byte(&glyphs[c].height);
+		int32_t  xo = (int8_t)pgm_read_byte(&glyphs[c].xOffset),
+				 yo = (int8_t)pgm_read_byte(&glyphs[c].yOffset);
+
+		uint32_t bit = 0;
+		for (int32_t yy = 0; yy < h; yy++) {
+			int32_t run = -1;
+			for (int32_t xx = 0; xx <= w; xx++, bit++) {
+				bool set = (xx < w) && (pgm_read_byte(bitmap + bo + (bit >> 3)) & (0x80 >> (bit & 7)));
+				if (set && run < 0) run = xx;
+				if (!set && run >= 0) {
+					atlas.spans.push_back({ xo + run, xo + xx - 1, yo + yy });
+					run = -1;
+				}
+			}
+			bit--; // The column after the row was not a bit
+		}
+	}
+	atlas.first.push_back(atlas.spans.size());
+}
+
+// Only the foreground is drawn, drawString() fills the background of free fonts
+void TFT_eSPI::drawFreeFontChar(int32_t x, int32_t y, uint16_t c, uint32_t color, uint8_t size)
+{
+	uint16_t first = pgm_read_word(&gfxFont->first);
+	if ((c < first) || (c > pgm_read_word(&gfxFont->last)) || !size) return;
+	c -= first;
+
+	std::shared_ptr<const free_font_atlas_t> font;
+	{
+		std::lock_guard<std::mutex> lock(glyphCacheLock);
+		auto it = freeFontAtlas.find(gfxFont);
+		if (it == freeFontAtlas.end()) {
+			auto atlas = std::make_shared<free_font_atlas_t>();
+			buildAtlas(gfxFont, *atlas);
+			it = freeFontAtlas.emplace(gfxFont, std::move(atlas)).first;
+		}
+		font = it->second;
+	}
+	const free_font_atlas_t &atlas = *font;
+
+	fb_span_t batch[64];
+	uint32_t n = 0;
+	for (uint32_t i = atlas.first[c]; i < atlas.first[c + 1]; i++) {
+		const fb_span_t &sp = atlas.spans[i];
+		for (int32_t r = 0; r < size; r++) {
+			batch[n++] = { x + sp.x0 * size, x + (sp.x1 + 1) * size - 1, y + sp.y * size + r };
+			if (n == 64) { textSpans(batch, n, color); n = 0; }
+		}
+	}
+	if (n) textSpans(batch, n, color);
+}
+#endif
+
+void TFT_eSPI::clearGlyphCache(void)
+{
+	std::lock_guard<std::mutex> lock(glyphCacheLock);
+	glyphCache.clear();
+	glyphCacheBytes = 0;
+#ifdef LOAD_GFXFF
+	freeFontAtlas.clear();
+#endif
+}
+
+// Draw a character of Fonts 2 to 8, returns the advance
+int16_t TFT_eSPI::drawCachedChar(uint16_t uniCode, int32_t x, int32_t y, uint8_t font)
+{
+	if ((font < 2) || (font > 8) || (uniCode < 32) || (uniCode > 127)) return 0;
+
+	// Fonts that are not loaded have no height
+	int32_t height = pgm_read_byte(&fontdata[font].height);
+	if (!height) return 0;
+
+	uint16_t index = uniCode - 32;
+	int32_t width = pgm_read_byte((const uint8_t *)pgm_read_ptr(&fontdata[font].widthtbl) + index);
+
+	int32_t xd = x + _xDatum;
+	int32_t yd = y + _yDatum;
+	if ((xd + width * textsize <= _vpX) || (xd >= _vpW) || (yd + height * textsize <= _vpY) || (yd >= _vpH))
+		return width * textsize;
+
+	uint32_t key = (uint32_t)font << 24 | (uint32_t)textsize << 16 | index;
+	std::shared_ptr<const glyph_entry_t> glyph;
+	{
+		std::lock_guard<std::mutex> lock(glyphCacheLock);
+		auto it = glyphCache.find(key);
+		if (it == glyphCache.end()) {
+			auto g = std::make_shared<glyph_entry_t>();
+			g->width = width * textsize;
+
+			std::vector<uint8_t> pixels;
+			decodeGlyph(font, index, width, height, pixels);
+			buildGlyph(pixels, width, height, textsize, *g);
+
+			size_t bytes = sizeof(*g) + (g->fg.size() + g->bg.size()) * sizeof(fb_span_t);
+			if (glyphCacheBytes + bytes > TFT_GLYPH_CACHE_BYTES) {
+				glyphCache.clear();
+				glyphCacheBytes = 0;
+			}
+			glyphCacheBytes += bytes;
+			it = glyphCache.emplace(key, std::move(g)).first;
+		}
+		glyph = it->second;
+	}
+
+	// The spans are moved to the character position in batches, drawSpans() clips them
+	auto draw = [&](const std::vector<fb_span_t> &spans, uint32_t color) {
+		fb_span_t batch[64];
+		for (size_t i = 0; i < spans.size(); ) {
+			uint32_t n = (uint32_t)std::min<size_t>(spans.size() - i, 64);
+			for (uint32_t j = 0; j < n; j++, i++)
+				batch[j] = { spans[i].x0 + x, spans[i].x1 + x, spans[i].y + y };
+			textSpans(batch, n, color);
+		}
+	};
+
+	if (textcolor != textbgcolor) draw(glyph->bg, textbgcolor);
+	draw(glyph->fg, textcolor);
+
+	return glyph->width;
+}
+
+// Spans of a string in the order they were drawn, fg is set for the foreground spans
+struct TFT_eSPI::text_record_t {
+	std::vector<fb_span_t> spans;
+	std::vector<uint8_t>   fg;
+	bool addsX = false; // The width returned by renderString() includes the x position
+};
+
+typedef struct {
+	std::vector<fb_span_t> fg, bg; // Spans relative to the string position, fg is drawn over bg
+	int32_t width;                 // Width returned by drawString() at x = 0
+	bool    addsX;
+	uint32_t bytes;
+} text_run_t;
+
+typedef std::list<std::pair<std::string, std::shared_ptr<const text_run_t>>> text_run_list_t;
+
+static text_run_list_t textRuns; // Most recently used first
+static std::unordered_map<std::string, text_run_list_t::iterator> textRunIndex;
+static text_cache_stats_t textCacheStats = {};
+
+void TFT_eSPI::textSpans(const fb_span_t *spans, uint32_t count, uint32_t color)
+{
+	if (!_textRecord) {
+		drawSpans(spans, count, color);
+		return;
+	}
+	_textRecord->spans.insert(_textRecord->spans.end(), spans, spans + count);
+	_textRecord->fg.insert(_textRecord->fg.end(), count, color == textcolor);
+}
+
+void TFT_eSPI::textRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color)
+{
+	if (!_textRecord) {
+		fillRect(x, y, w, h, color);
+		return;
+	}
+	for (int32_t r = 0; r < h && w > 0; r++) {
+		fb_span_t span = { x, x + w - 1, y + r };
+		textSpans(&span, 1, color);
+	}
+}
+
+// Later spans overdraw earlier ones, paint them into a mask of the string and collect its runs.
+// The background runs go under the foreground, a row of opaque text has one background span.
+static void resolveRun(const std::vector<fb_span_t> &spans, const std::vector<uint8_t> &fg, int32_t ox, text_run_t &run)
+{
+	if (spans.empty()) return;
+
+	fb_rect_t box = { INT32_MAX, INT32_MAX, INT32_MIN, INT32_MIN };
+	for (const fb_span_t &sp : spans) {
+		box.x0 = std::min(box.x0, sp.x0);
+		box.x1 = std::max(box.x1, sp.x1 + 1);
+		box.y0 = std::min(box.y0, sp.y);
+		box.y1 = std::max(box.y1, sp.y + 1);
+	}
+
+	int32_t w = box.x1 - box.x0, h = box.y1 - box.y0;
+	std::vector<uint8_t> mask(w * h, 0); // 1 for the foreground, 2 for the background
+	for (size_t i = 0; i < spans.size(); i++) {
+		const fb_span_t &sp = spans[i];
+		if (sp.x0 > sp.x1) continue;
+		memset(mask.data() + (sp.y - box.y0) * w + sp.x0 - box.x0, fg[i] ? 1 : 2, sp.x1 - sp.x0 + 1);
+	}
+
+	for (int32_t y = 0; y < h; y++) {
+		const uint8_t *row = mask.data() + y * w;
+		for (int32_t x = 0; x < w; ) {
+			int32_t x1 = x;
+			while ((x1 < w) && (row[x1] == row[x])) x1++;
+			if (row[x] == 1) run.fg.push_back({ box.x0 - ox + x, box.x0 - ox + x1 - 1, box.y0 + y });
+			x = x1;
+		}
+		for (int32_t x = 0; x < w; ) {
+			int32_t x1 = x;
+			bool bg = false;
+			while ((x1 < w) && row[x1]) bg |= (row[x1++] == 2);
+			if (bg) run.bg.push_back({ box.x0 - ox + x, box.x0 - ox + x1 - 1, box.y0 + y });
+			x = x1 + 1;
+		}
+	}
+	run.fg.shrink_to_fit();
+	run.bg.shrink_to_fit();
+}
+
+text_cache_stats_t TFT_eSPI::getTextCacheStats(void)
+{
+	std::lock_guard<std::mutex> lock(glyphCacheLock);
+	textCacheStats.runs = textRuns.size();
+	return textCacheStats;
+}
+
+void TFT_eSPI::resetTextCacheStats(void)
+{
+	std::lock_guard<std::mutex> lock(glyphCacheLock);
+	textCacheStats.hits = textCacheStats.misses = 0;
+}
+
+void TFT_eSPI::clearTextCache(void)
+{
+	std::lock_guard<std::mutex> lock(glyphCacheLock);
+	textRuns.clear();
+	textRunIndex.clear();
+	textCacheStats.bytes = 0;
+}
+
+int16_t TFT_eSPI::drawTextRun(const char *string, int32_t x, int32_t y, uint8_t font)
+{
+#ifdef SMOOTH_FONT
+	// Anti-aliased glyphs are blended with the pixels under them
+	if (fontLoaded) return renderString(string, x, y, font);
+#endif
+	if ((TFT_TEXT_CACHE_BYTES == 0) || _vpOoB) return renderString(string, x, y, font);
+
+	// The colours only matter if the background is drawn, the string ends the key.
+	// isDigits changes the width of numbers, _utf8 and _cp437 the decoding of the string.
+	std::string key;
+	auto add = [&](const void *p, size_t n) { key.append((const char *)p, n); };
+	uint8_t params[7] = { font, textsize, textdatum, textcolor != textbgcolor, isDigits, _utf8, _cp437 };
+	add(params, sizeof(params));
+	add(&padX, sizeof(padX));
+#ifdef LOAD_GFXFF
+	const GFXfont *gfx = (font == 1) ? gfxFont : nullptr;
+	add(&gfx, sizeof(gfx));
+#endif
+	key.append(string);
+
+	// The run is looked up and stored under the lock, it is rendered and drawn without it
+	std::shared_ptr<const text_run_t> run;
+	{
+		std::lock_guard<std::mutex> lock(glyphCacheLock);
+		auto it = textRunIndex.find(key);
+		if (it != textRunIndex.end()) {
+			textCacheStats.hits++;
+			textRuns.splice(textRuns.begin(), textRuns, it->second);
+			run = it->second->second;
+			isDigits = false; // Reset by textWidth() when the string is rendered
+		}
+		else
+			textCacheStats.misses++;
+	}
+
+	if (!run) {
+
+		// Rendered in a viewport that culls nothing, the spans are clipped when the run is drawn.
+		// Left padding is clipped at x = 0 by renderString(), the string is rendered right of it.
+		int32_t ox = std::max<int32_t>(padX, 0) + 4096;
+		int32_t vpX = _vpX, vpY = _vpY, vpW = _vpW, vpH = _vpH;
+		_vpX = _vpY = -(1 << 28);
+		_vpW = _vpH =   1 << 28;
+
+		text_record_t record;
+		_textRecord = &record;
+		auto uncached = std::make_shared<text_run_t>();
+		uncached->width = renderString(string, ox, 0, font);
+		_textRecord = nullptr;
+
+		_vpX = vpX; _vpY = vpY; _vpW = vpW; _vpH = vpH;
+
+		uncached->addsX = record.addsX;
+		if (uncached->addsX) uncached->width -= ox;
+		resolveRun(record.spans, record.fg, ox, *uncached);
+		uncached->bytes = sizeof(text_run_list_t::value_type) + sizeof(text_run_t) + 2 * key.size() +
+								(uncached->fg.size() + uncached->bg.size()) * sizeof(fb_span_t);
+		run = uncached;
+
+		// Another display may have cached the same string meanwhile, its run is replaced
+		std::lock_guard<std::mutex> lock(glyphCacheLock);
+		auto it = textRunIndex.find(key);
+		if (it != textRunIndex.end()) {
+			textCacheStats.bytes -= it->second->second->bytes;
+			textRuns.erase(it->second);
+			textRunIndex.erase(it);
+		}
+		if (run->bytes <= TFT_TEXT_CACHE_BYTES) {
+			while (textCacheStats.bytes + run->bytes > TFT_TEXT_CACHE_BYTES) {
+				textCacheStats.bytes -= textRuns.back().second->bytes;
+				textRunIndex.erase(textRuns.back().first);
+				textRuns.pop_back();
+			}
+			textCacheStats.bytes += run->bytes;
+			textRuns.emplace_front(key, run);
+			textRunIndex.emplace(std::move(key), textRuns.begin());
+		}
+	}
+
+	// The datum moves to the string position, the spans are drawn as they are
+	_xDatum += x;
+	_yDatum += y;
+	if (!run->bg.empty()) drawSpans(run->bg.data(), run->bg.size(), textbgcolor);
+	if (!run->fg.empty()) drawSpans(run->fg.data(), run->fg.size(), textcolor);
+	_xDatum -= x;
+	_yDatum -= y;
+
+	return run->addsX ? run->width + x : run->width;
+}
@@ -0,0 +1,317 @@
+/***************************************************************************************
+** Code for the SDL presenter thread, see Presenter.h
+***************************************************************************************/
+
+// Grow a to include b, empty rectangles (x0 >= x1) are ignored
+static void rectUnion(fb_rect_t &a, const fb_rect_t &b)
+{
+	if (b.x0 >= b.x1 || b.y0 >= b.y1) return;
+	if (a.x0 >= a.x1 || a.y0 >= a.y1) { a = b; return; }
+	a = { std::min(a.x0, b.x0), std::min(a.y0, b.y0), std::max(a.x1, b.x1), std::max(a.y1, b.y1) };
+}
+
+TFT_ePresenter::host_t &TFT_ePresenter::host(void)
+{
+	static host_t *shared = new host_t;
+	return *shared;
+}
+
+TFT_ePresenter::TFT_ePresenter(int32_t w, int32_t h)
+{
+	_width  = w;
+	_height = h;
+
+	for (uint8_t i = 0; i < 3; i++) {
+		_frames[i].pixels = new uint16_t[w * h]();
+		_frames[i].width  = w;
+		_frames[i].height = h;
+		_frames[i].count  = 0;
+		_frames[i].turns  = 0;
+		_frames[i].invert = false;
+		_stale[i] = { 0, 0, 0, 0 };
+	}
+
+	_back  = 0;
+	_middle.store(1);
+	_front = 2;
+	_carryCount = 0;
+
+	_window   = nullptr;
+	_renderer = nullptr;
+	_texture  = nullptr;
+	_windowID = 0;
+
+	// The window is created by the presenter thread, errors are passed back to the caller
+	host_t &shared = host();
+	std::promise<void> ready;
+	std::future<void> opened = ready.get_future();
+	{
+		std::lock_guard<std::mutex> guard(shared.lock);
+		shared.requests.push_back({ this, true, &ready });
+		if (!shared.running) {
+			// A thread that stopped after its last display was closed no longer needs the lock
+			if (shared.thread.joinable()) shared.thread.join();
+			shared.running = true;
+			shared.thread = std::thread(&TFT_ePresenter::run);
+		}
+	}
+
+	try {
+		opened.get();
+	}
+	catch (...) {
+		for (uint8_t i = 0; i < 3; i++) delete [] _frames[i].pixels;
+		throw;
+	}
+}
+
+TFT_ePresenter::~TFT_ePresenter(void)
+{
+	host_t &shared = host();
+	std::promise<void> done;
+	std::future<void> closed = done.get_future();
+	{
+		std::lock_guard<std::mutex> guard(shared.lock);
+		shared.requests.push_back({ this, false, &done });
+	}
+	closed.get();
+
+	// The last display joins the thread, unless a new display has started another one
+	{
+		std::lock_guard<std::mutex> guard(shared.lock);
+		if (!shared.running && shared.thread.joinable()) shared.thread.join();
+	}
+
+	for (uint8_t i = 0; i < 3; i++) delete [] _frames[i].pixels;
+}
+
+void TFT_ePresenter::submit(const uint16_t *fb, int32_t w, int32_t h, const fb_rect_t *damage, uint8_t count,
+									 uint8_t turns, bool invert)
+{
+	frame_t &f = _frames[_back];
+
+	// Bounding box of the new damage
+	fb_rect_t bounds = { 0, 0, 0, 0 };
+	for (uint8_t i = 0; i < count; i++) rectUnion(bounds, damage[i]);
+
+	// The buffer missed all frames submitted since it was last written, copy those areas too
+	fb_rect_t copy = _stale[_back];
+	rectUnion(copy, bounds);
+	// A rotation changes the size, or leaves areas of the old orientation
+	if (f.width != w || f.height != h) copy = { 0, 0, w, h };
+	copy = { copy.x0, copy.y0, std::min(copy.x1, w), std::min(copy.y1, h) };
+	for (int32_t y = copy.y0; y < copy.y1; y++)
+		memcpy(f.pixels + y * w + copy.x0, fb + y * w + copy.x0, (copy.x1 - copy.x0) * sizeof(uint16_t));
+	f.width  = w;
+	f.height = h;
+	f.turns  = turns;
+	f.invert = invert;
+
+	for (uint8_t i = 0; i < 3; i++) rectUnion(_stale[i], bounds);
+	_stale[_back] = { 0, 0, 0, 0 };
+
+	// If the presenter has not picked up the previous frame it will never be shown,
+	// so its damage is shown with this frame. A frame picked up right after this
+	// check only causes a slightly larger upload.
+	f.count = 0;
+	if (_middle.load(std::memory_order_acquire) & FRAME_FRESH) {
+		for (uint8_t i = 0; i < _carryCount; i++) f.damage[f.count++] = _carry[i];
+	}
+	for (uint8_t i = 0; i < count; i++) {
+		if (f.count < TFT_DAMAGE_RECTS) f.damage[f.count++] = damage[i];
+		else rectUnion(f.damage[TFT_DAMAGE_RECTS - 1], damage[i]);
+	}
+	memcpy(_carry, f.damage, f.count * sizeof(fb_rect_t));
+	_carryCount = f.count;
+
+	_back = _middle.exchange(_back | FRAME_FRESH, std::memory_order_acq_rel) & FRAME_INDEX;
+}
+
+// One loop serves all displays: open and close windows, route events, show new frames
+void TFT_ePresenter::run(void)
+{
+	host_t &shared = host();
+
+	// Failures show up as an error of SDL_CreateWindow
+	SDL_Init(SDL_INIT_VIDEO);
+
+	// A vsync wait per window would divide the frame rate by the number of displays,
+	// so the loop paces itself to the refresh rate and presents all windows together
+	SDL_DisplayMode mode;
+	int hz = (SDL_GetCurrentDisplayMode(0, &mode) == 0 && mode.refresh_rate > 0) ? mode.refresh_rate : 60;
+	std::chrono::microseconds period(1000000 / hz);
+
+	while (serve()) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		pollEvents();
+
+		bool shown = false;
+		for (TFT_ePresenter *display : shared.displays) shown |= display->update();
+
+		if (shown) std::this_thread::sleep_until(start + period);
+		else       std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	SDL_Quit();
+}
+
+// Open and close the windows requested by the sketch threads, false when no display is left
+bool TFT_ePresenter::serve(void)
+{
+	host_t &shared = host();
+
+	std::vector<request_t> requests;
+	{
+		std::lock_guard<std::mutex> guard(shared.lock);
+		requests.swap(shared.requests);
+	}
+
+	for (request_t &r : requests) {
+		if (r.open) {
+			try {
+				r.display->open();
+				shared.displays.push_back(r.display);
+			}
+			catch (...) {
+				r.display->close();
+				r.done->set_exception(std::current_exception());
+				r.done = nullptr;
+			}
+		}
+		else {
+			r.display->close();
+			shared.displays.erase(std::remove(shared.displays.begin(), shared.displays.end(), r.display), shared.displays.end());
+		}
+	}
+
+	// Decided before the requests are answered, so the last destructor sees the thread stopping
+	bool running;
+	{
+		std::lock_guard<std::mutex> guard(shared.lock);
+		if (shared.displays.empty() && shared.requests.empty()) shared.running = false;
+		running = shared.running;
+	}
+
+	for (request_t &r : requests)
+		if (r.done) r.done->set_value();
+
+	return running;
+}
+
+void TFT_ePresenter::open(void)
+{
+	// Further displays are numbered and placed by the window manager
+	uint32_t n = ++host().opened;
+	std::string title = n == 1 ? "Arduino" : "Arduino " + std::to_string(n);
+	int pos = n == 1 ? SDL_WINDOWPOS_CENTERED : SDL_WINDOWPOS_UNDEFINED;
+
+	_window = SDL_CreateWindow(title.c_str(), pos, pos, _width, _height, 0);
+	if (!_window)
+		throw std::runtime_error("SDL_CreateWindow failed: " + std::string(SDL_GetError()));
+	_windowID = SDL_GetWindowID(_window);
+
+	_renderer = SDL_CreateRenderer(_window, -1, 0);
+	if (!_renderer)
+		throw std::runtime_error("SDL_CreateRenderer failed: " + std::string(SDL_GetError()));
+
+	// The frame buffer is uploaded through a streaming texture of the same format
+	_texture = SDL_CreateTexture(_renderer, SDL_PIXELFORMAT_RGB565, SDL_TEXTUREACCESS_STREAMING, _width, _height);
+	if (!_texture)
+		throw std::runtime_error("SDL_CreateTexture failed: " + std::string(SDL_GetError()));
+}
+
+void TFT_ePresenter::close(void)
+{
+	if (_texture)  SDL_DestroyTexture(_texture);
+	if (_renderer) SDL_DestroyRenderer(_renderer);
+	if (_window)   SDL_DestroyWindow(_window);
+	_texture  = nullptr;
+	_renderer = nullptr;
+	_window   = nullptr;
+	_windowID = 0;
+}
+
+// Show the newest frame if the sketch has completed one since the last call
+bool TFT_ePresenter::update(void)
+{
+	if (!(_middle.load(std::memory_order_acquire) & FRAME_FRESH)) return false;
+
+	_front = _middle.exchange(_front, std::memory_order_acq_rel) & FRAME_INDEX;
+	show(_frames[_front]);
+	return true;
+}
+
+// Upload the damaged areas of a frame to the streaming texture and show it
+// Rotation and inversion are applied here, so drawing never pays for them
+void TFT_ePresenter::show(const frame_t &frame)
+{
+	int32_t w = frame.width, h = frame.height;
+
+	for (uint8_t i = 0; i < frame.count; i++) {
+		const fb_rect_t &r = frame.damage[i];
+		const uint16_t *src = frame.pixels + r.y0 * w + r.x0;
+		int32_t rw = r.x1 - r.x0, rh = r.y1 - r.y0;
+
+		if (!frame.turns && !frame.invert) {
+			SDL_Rect rect = { r.x0, r.y0, rw, rh };
+			SDL_UpdateTexture(_texture, &rect, src, w * sizeof(uint16_t));
+			continue;
+		}
+
+		// The area in the window, see rotateBlock()
+		SDL_Rect rect;
+		switch (frame.turns) {
+			case 0:  rect = { r.x0,     r.y0,     rw, rh }; break;
+			case 1:  rect = { h - r.y1, r.x0,     rh, rw }; break;
+			case 2:  rect = { w - r.x1, h - r.y1, rw, rh }; break;
+			default: rect = { r.y0,     w - r.x1, rh, rw }; break;
+		}
+
+		void *pixels;
+		int pitch;
+		if (SDL_LockTexture(_texture, &rect, &pixels, &pitch) != 0) continue;
+		rotateBlock(src, w, rw, rh, (uint16_t *)pixels, pitch / sizeof(uint16_t), frame.turns, frame.invert ? 0xFFFF : 0);
+		SDL_UnlockTexture(_texture);
+	}
+	SDL_RenderCopy(_renderer, _texture, nullptr, nullptr);
+	SDL_RenderPresent(_renderer);
+}
+
+void TFT_ePresenter::pollEvents(void)
+{
+	host_t &shared = host();
+
+	SDL_Event event;
+	while(SDL_PollEvent(&event)) {
+		// Events that belong to a window go to its display, all others go to every display
+		uint32_t id = 0;
+		switch (event.type) {
+			case SDL_WINDOWEVENT:     id = event.window.windowID; break;
+			case SDL_KEYDOWN:
+			case SDL_KEYUP:           id = event.key.windowID;    break;
+			case SDL_MOUSEMOTION:     id = event.motion.windowID; break;
+			case SDL_MOUSEBUTTONDOWN:
+			case SDL_MOUSEBUTTONUP:   id = event.button.windowID; break;
+			case SDL_MOUSEWHEEL:      id = event.wheel.windowID;  break;
+		}
+
+		for (TFT_ePresenter *display : shared.displays)
+			if (id == 0 || display->_windowID == id) display->event(event);
+	}
+}
+
+void TFT_ePresenter::event(const SDL_Event &e)
+{
+	// The window content was lost, show the texture again
+	if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_EXPOSED) {
+		SDL_RenderCopy(_renderer, _texture, nullptr, nullptr);
+		SDL_RenderPresent(_renderer);
+	}
+	/*if (e.type == SDL_QUIT) {
+		throw std::runtime_error("exit");
+	} else if (e.type == SDL_KEYUP) {
+		if (e.key.keysym.sym == SDLK_ESCAPE)
+			throw std::runtime_error("exit");
+	}*/
+}
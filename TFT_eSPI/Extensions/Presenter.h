@@ -0,0 +1,93 @@
+/***************************************************************************************
+// The presenter shows the frame buffer of a TFT_eSPI instance in an SDL window.
+// Every display gets its own presenter with its own window, renderer and texture. All
+// windows and the SDL event loop are owned by one shared presenter thread, so a slow
+// present never stalls a sketch and any number of displays can be shown side by side.
+// Completed frames are handed over through three buffers: the sketch fills the back
+// buffer and swaps it with the middle buffer, the presenter thread swaps the middle
+// buffer with its front buffer when a new frame is available. The swaps are single
+// atomic exchanges, so neither side ever waits for the other.
+***************************************************************************************/
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct SDL_Window;
+struct SDL_Renderer;
+struct SDL_Texture;
+union  SDL_Event;
+
+class TFT_ePresenter {
+
+ public:
+
+  TFT_ePresenter(int32_t w, int32_t h);
+  ~TFT_ePresenter(void);
+
+           // Hand over the frame buffer, only the damaged areas are copied and shown
+           // The frame is turned clockwise by turns quarter turns (and inverted) when it is uploaded
+           // Called by the sketch thread, never blocks
+  void     submit(const uint16_t *fb, int32_t w, int32_t h, const fb_rect_t *damage, uint8_t count,
+                  uint8_t turns, bool invert);
+
+ private:
+
+  struct frame_t {
+    uint16_t *pixels;
+    int32_t  width, height;
+    fb_rect_t damage[TFT_DAMAGE_RECTS]; // Areas changed since the frame before
+    uint8_t  count;
+    uint8_t  turns;                     // Quarter turns from the frame to the window
+    bool     invert;
+  };
+
+           // Window open and close requests served by the presenter thread
+  struct request_t {
+    TFT_ePresenter *display;
+    bool     open;
+    std::promise<void> *done;
+  };
+
+           // State shared by all presenters, never destroyed so it outlives global displays
+  struct host_t {
+    std::mutex lock;               // Guards requests and running
+    std::vector<request_t> requests;
+    bool     running = false;
+    std::thread thread;
+    std::vector<TFT_ePresenter*> displays; // Open displays (presenter thread only)
+    uint32_t opened = 0;           // Number of windows opened so far, used for titles
+  };
+  static host_t &host(void);
+
+           // Presenter thread functions
+  static void run(void);
+  static bool serve(void);
+  static void pollEvents(void);
+  void     open(void);
+  void     close(void);
+  bool     update(void);
+  void     show(const frame_t &frame);
+  void     event(const SDL_Event &e);
+
+           // Bits of _middle
+           #define FRAME_INDEX 0x03
+           #define FRAME_FRESH 0x80 // Middle buffer holds a frame that has not been shown yet
+
+  frame_t  _frames[3];
+  std::atomic<uint8_t> _middle;  // Index of the last completed frame and FRAME_FRESH flag
+  uint8_t  _back;                // Buffer the sketch thread writes next (sketch thread only)
+  uint8_t  _front;               // Buffer shown last (presenter thread only)
+
+  fb_rect_t _stale[3];           // Area of each buffer older than the frame buffer (sketch thread only)
+  fb_rect_t _carry[TFT_DAMAGE_RECTS]; // Damage of the last submitted frame (sketch thread only)
+  uint8_t  _carryCount;
+
+  int32_t  _width, _height;      // Window size, the panel in its mounted orientation
+
+  SDL_Window   *_window;
+  SDL_Renderer *_renderer;
+  SDL_Texture  *_texture;
+  uint32_t      _windowID;       // Events are routed to the presenter by window ID
+};
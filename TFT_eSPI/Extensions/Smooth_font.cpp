@@ -0,0 +1,403 @@
+/***************************************************************************************
+** Anti-aliased fonts in the Processing .vlw format. A .vlw file is a header of 6 big
+** endian 32 bit words, the 7 word metrics of each glyph and the 8 bit alpha bitmaps of
+** the glyphs in the same order. The file is mapped into memory rather than read, the
+** bitmaps are used where they are. A hash table of the code points finds the glyphs.
+** The pixels of a glyph row from the first to the last edge pixel are blended with one
+** drawCoverage() call, opaque runs outside them are spans and, when the background is
+** filled, so are the transparent runs.
+***************************************************************************************/
+#ifdef _WIN32
+  #ifndef NOMINMAX
+    #define NOMINMAX
+  #endif
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+// Slot of a code point in the glyph index
+static inline uint32_t glyphSlot(uint16_t unicode, uint32_t mask)
+{
+	return ((unicode * 0x9E3779B1u) >> 15) & mask;
+}
+
+void TFT_eSPI::loadFont(const uint8_t array[])
+{
+	if (array == nullptr) return;
+	if (fontLoaded) unloadFont();
+
+	fontPtr = array;
+	if (!loadMetrics(0)) unloadFont();
+}
+
+void TFT_eSPI::loadFont(String fontName, bool flash)
+{
+	(void)flash;
+	if (fontLoaded) unloadFont();
+
+	if (!fontName.endsWith(".vlw")) fontName += ".vlw";
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(fontName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return;
+
+	LARGE_INTEGER size;
+	HANDLE mapping = NULL;
+	if (GetFileSizeEx(file, &size) && size.QuadPart) mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping) {
+		fontMap = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping); // The view keeps the mapping
+	}
+	CloseHandle(file);
+	if (!fontMap) return;
+	fontMapSize = size.QuadPart;
+#else
+	int fd = open(fontName.c_str(), O_RDONLY);
+	if (fd < 0) return;
+
+	struct stat st;
+	void *map = MAP_FAILED;
+	if ((fstat(fd, &st) == 0) && (st.st_size > 0)) map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // The mapping keeps the file
+	if (map == MAP_FAILED) return;
+	fontMap = map;
+	fontMapSize = st.st_size;
+#endif
+
+	fontPtr = (const uint8_t *)fontMap;
+	if ((fontMapSize > UINT32_MAX) || !loadMetrics(fontMapSize)) unloadFont();
+}
+
+uint32_t TFT_eSPI::readInt32(void)
+{
+	uint32_t val = (uint32_t)pgm_read_byte(fontPtr) << 24 | (uint32_t)pgm_read_byte(fontPtr + 1) << 16 |
+						(uint32_t)pgm_read_byte(fontPtr + 2) << 8 | pgm_read_byte(fontPtr + 3);
+	fontPtr += 4;
+	return val;
+}
+
+// Read the font and glyph metrics, size is the size of a font file or 0 for a C array.
+// False if a file is too short for its glyphs.
+bool TFT_eSPI::loadMetrics(uint32_t size)
+{
+	if (size && (size < 24)) return false;
+
+	gFont.gArray   = fontPtr;
+	gFont.gCount   = (uint16_t)readInt32(); // glyph count in file
+										  readInt32(); // vlw encoder version - discard
+	gFont.yAdvance = (uint16_t)readInt32(); // Font size in points, not pixels
+										  readInt32(); // discard
+	gFont.ascent   = (uint16_t)readInt32(); // top of "d"
+	gFont.descent  = (uint16_t)readInt32(); // bottom of "p"
+
+	// These next gFont values might be updated when the Metrics are fetched
+	gFont.maxAscent  = gFont.ascent;   // Determined from metrics
+	gFont.maxDescent = gFont.descent;  // Determined from metrics
+	gFont.yAdvance   = gFont.ascent + gFont.descent;
+	gFont.spaceWidth = gFont.yAdvance / 4;  // Guess at space width
+
+	uint32_t bitmapPtr = 24 + gFont.gCount * 28;
+	if (size && (bitmapPtr > size)) return false;
+
+	gUnicode  = (uint16_t*)malloc( gFont.gCount * 2); // Unicode 16 bit Basic Multilingual Plane (0-FFFF)
+	gHeight   =  (uint8_t*)malloc( gFont.gCount );    // Height of glyph
+	gWidth    =  (uint8_t*)malloc( gFont.gCount );    // Width of glyph
+	gxAdvance =  (uint8_t*)malloc( gFont.gCount );    // xAdvance - to move x cursor
+	gdY       =  (int16_t*)malloc( gFont.gCount * 2); // offset from bitmap top edge from lowest point in any character
+	gdX       =   (int8_t*)malloc( gFont.gCount );    // offset for bitmap left edge relative to cursor X
+	gBitmap   = (uint32_t*)malloc( gFont.gCount * 4); // offset of the glyph bitmap in the font
+
+	// At most half of the index slots are used
+	uint32_t slots = 1;
+	while (slots < 2u * gFont.gCount) slots <<= 1;
+	gIndex     = (uint16_t*)calloc(slots, 2);
+	gIndexMask = slots - 1;
+
+	if (!gUnicode || !gHeight || !gWidth || !gxAdvance || !gdY || !gdX || !gBitmap || !gIndex) return false;
+
+	for (uint16_t gNum = 0; gNum < gFont.gCount; gNum++)
+	{
+		gUnicode[gNum]  = (uint16_t)readInt32(); // Unicode code point value
+		gHeight[gNum]   =  (uint8_t)readInt32(); // Height of glyph
+		gWidth[gNum]    =  (uint8_t)readInt32(); // Width of glyph
+		gxAdvance[gNum] =  (uint8_t)readInt32(); // xAdvance - to move x cursor
+		gdY[gNum]       =  (int16_t)readInt32(); // y delta from baseline
+		gdX[gNum]       =   (int8_t)readInt32(); // x delta from cursor
+		readInt32(); // ignored
+
+		// Different glyph sets have different descent values not always based on "p", so get maximum glyph descent
+		if (((int16_t)gHeight[gNum] - (int16_t)gdY[gNum]) > gFont.maxDescent)
+		{
+			// Avoid UTF coding values and characters that tend to give duff values
+			if (((gUnicode[gNum] > 0x20) && (gUnicode[gNum] < 0x7F)) || (gUnicode[gNum] > 0xA0))
+			{
+				gFont.maxDescent = gHeight[gNum] - gdY[gNum];
+			}
+		}
+
+		gBitmap[gNum] = bitmapPtr;
+		bitmapPtr += gWidth[gNum] * gHeight[gNum];
+		if (size && (bitmapPtr > size)) return false;
+
+		// The first glyph of a code point is kept, like a search of gUnicode would find it
+		uint32_t slot = glyphSlot(gUnicode[gNum], gIndexMask);
+		while (gIndex[slot] && (gUnicode[gIndex[slot] - 1] != gUnicode[gNum])) slot = (slot + 1) & gIndexMask;
+		if (!gIndex[slot]) gIndex[slot] = gNum + 1;
+	}
+
+	gFont.yAdvance = gFont.maxAscent + gFont.maxDescent;
+	gFont.spaceWidth = (gFont.ascent + gFont.descent) * 2/7;  // Guess at space width if it is not in the font
+
+	uint16_t space;
+	if (getUnicodeIndex(' ', &space)) gFont.spaceWidth = gxAdvance[space];
+
+	fontLoaded = true;
+	return true;
+}
+
+void TFT_eSPI::unloadFont( void )
+{
+	free(gUnicode);  gUnicode  = NULL;
+	free(gHeight);   gHeight   = NULL;
+	free(gWidth);    gWidth    = NULL;
+	free(gxAdvance); gxAdvance = NULL;
+	free(gdY);       gdY       = NULL;
+	free(gdX);       gdX       = NULL;
+	free(gBitmap);   gBitmap   = NULL;
+	free(gIndex);    gIndex    = NULL;
+	gIndexMask = 0;
+
+	if (fontMap) {
+#ifdef _WIN32
+		UnmapViewOfFile(fontMap);
+#else
+		munmap(fontMap, fontMapSize);
+#endif
+		fontMap = nullptr;
+		fontMapSize = 0;
+	}
+
+	gFont.gArray = nullptr;
+	fontPtr = nullptr;
+	fontLoaded = false;
+}
+
+bool TFT_eSPI::getUnicodeIndex(uint16_t unicode, uint16_t *index)
+{
+	if (!gIndex) return false;
+
+	for (uint32_t slot = glyphSlot(unicode, gIndexMask); gIndex[slot]; slot = (slot + 1) & gIndexMask) {
+		if (gUnicode[gIndex[slot] - 1] == unicode) {
+			*index = gIndex[slot] - 1;
+			return true;
+		}
+	}
+	return false;
+}
+
+void TFT_eSPI::drawGlyphRows(uint16_t gNum, int32_t x, int32_t y, int32_t bx)
+{
+	int32_t w = gWidth[gNum], h = gHeight[gNum];
+
+	// Rows and columns in the viewport, relative to the datum
+	int32_t vx0 = _vpX - _xDatum, vx1 = _vpW - _xDatum;
+	int32_t vy0 = _vpY - _yDatum, vy1 = _vpH - _yDatum;
+	if ((x >= vx1) || (x + w <= vx0)) return;
+
+	uint32_t fg = textcolor, bg = textbgcolor;
+	uint32_t under = (fg == bg) ? 0x00FFFFFF : bg; // Text without a background blends with the pixels under it
+
+	fb_span_t fgSpans[64], bgSpans[64];
+	uint32_t fgCount = 0, bgCount = 0;
+	auto add = [&](fb_span_t *spans, uint32_t &count, int32_t x0, int32_t x1, int32_t yr, uint32_t col) {
+		spans[count++] = { x0, x1, yr };
+		if (count == 64) { drawSpans(spans, count, col); count = 0; }
+	};
+
+	const uint8_t *bitmap = gFont.gArray + gBitmap[gNum];
+	for (int32_t r = std::max(0, vy0 - y); r < std::min(h, vy1 - y); r++) {
+		const uint8_t *alpha = bitmap + r * w;
+		int32_t yr = y + r;
+
+		// Pixels from the first to the last edge pixel are blended in one call, the rest are spans
+		int32_t e0 = w, e1 = -1;
+		if (!getColor) {
+			for (int32_t i = 0; i < w; i++) if (alpha[i] && (alpha[i] != 0xFF)) { e0 = std::min(e0, i); e1 = i; }
+			if (e1 >= 0) drawCoverage(x + e0, yr, e1 - e0 + 1, alpha + e0, fg, under);
+		}
+
+		for (int32_t i = 0; i < w; ) {
+			int32_t j = i;
+			if (!alpha[i]) {
+				while ((j < w) && !alpha[j]) j++;
+				if (_fillbg && (j > bx)) add(bgSpans, bgCount, x + std::max(i, bx), x + j - 1, yr, bg);
+			}
+			else if (alpha[i] == 0xFF) {
+				while ((j < w) && (alpha[j] == 0xFF)) j++;
+				if ((j <= e0) || (i > e1)) add(fgSpans, fgCount, x + i, x + j - 1, yr, fg);
+			}
+			else {
+				while ((j < w) && alpha[j] && (alpha[j] != 0xFF)) j++;
+				if (getColor) {
+					for (int32_t k = i; k < j; k++)
+						drawPixel(x + k, yr, alphaBlend(alpha[k], fg, getColor(x + k, yr)));
+				}
+			}
+			i = j;
+		}
+	}
+
+	if (fgCount) drawSpans(fgSpans, fgCount, fg);
+	if (bgCount) drawSpans(bgSpans, bgCount, bg);
+}
+
+/***************************************************************************************
+** Function name:           drawGlyph
+** Description:             Write a character to the TFT cursor position
+***************************************************************************************/
+void TFT_eSPI::drawGlyph(uint16_t code)
+{
+	BUS_PRIMITIVE("drawGlyph");
+
+	uint16_t fg = textcolor;
+	uint16_t bg = textbgcolor;
+
+	// Check if cursor has moved
+	if (last_cursor_x != cursor_x)
+	{
+		bg_cursor_x = cursor_x;
+		last_cursor_x = cursor_x;
+	}
+
+	if (code < 0x21)
+	{
+		if (code == 0x20) {
+			if (_fillbg) fillRect(bg_cursor_x, cursor_y, (cursor_x + gFont.spaceWidth) - bg_cursor_x, gFont.yAdvance, bg);
+			cursor_x += gFont.spaceWidth;
+			bg_cursor_x = cursor_x;
+			last_cursor_x = cursor_x;
+			return;
+		}
+
+		if (code == '\n') {
+			cursor_x = 0;
+			bg_cursor_x = 0;
+			last_cursor_x = 0;
+			cursor_y += gFont.yAdvance;
+			if (textwrapY && (cursor_y >= height())) cursor_y = 0;
+			return;
+		}
+	}
+
+	uint16_t gNum = 0;
+	bool found = getUnicodeIndex(code, &gNum);
+
+	if (found)
+	{
+		if (textwrapX && (cursor_x + gWidth[gNum] + gdX[gNum] > width()))
+		{
+			cursor_y += gFont.yAdvance;
+			cursor_x = 0;
+			bg_cursor_x = 0;
+		}
+		if (textwrapY && ((cursor_y + gFont.yAdvance) >= height())) cursor_y = 0;
+		if (cursor_x == 0) cursor_x -= gdX[gNum];
+
+		int16_t cy = cursor_y + gFont.maxAscent - gdY[gNum];
+		int16_t cx = cursor_x + gdX[gNum];
+		int16_t bx = 0;
+
+		int16_t fillwidth  = 0;
+		int16_t fillheight = 0;
+
+		// Fill area above glyph
+		if (_fillbg) {
+			fillwidth  = (cursor_x + gxAdvance[gNum]) - bg_cursor_x;
+			if (fillwidth > 0) {
+				fillheight = gFont.maxAscent - gdY[gNum];
+				if (fillheight > 0) {
+					fillRect(bg_cursor_x, cursor_y, fillwidth, fillheight, textbgcolor);
+				}
+			}
+			else {
+				// Could be negative
+				fillwidth = 0;
+			}
+
+			// Fill any area to left of glyph
+			if (bg_cursor_x < cx) fillRect(bg_cursor_x, cy, cx - bg_cursor_x, gHeight[gNum], textbgcolor);
+			// Set x position in glyph area where background starts
+			if (bg_cursor_x > cx) bx = bg_cursor_x - cx;
+			// Fill any area to right of glyph
+			if (cx + gWidth[gNum] < cursor_x + gxAdvance[gNum]) {
+				fillRect(cx + gWidth[gNum], cy, (cursor_x + gxAdvance[gNum]) - (cx + gWidth[gNum]), gHeight[gNum], textbgcolor);
+			}
+		}
+
+		drawGlyphRows(gNum, cx, cy, bx);
+
+		// Fill area below glyph
+		if (fillwidth > 0) {
+			fillheight = (cursor_y + gFont.yAdvance) - (cy + gHeight[gNum]);
+			if (fillheight > 0) {
+				fillRect(bg_cursor_x, cy + gHeight[gNum], fillwidth, fillheight, textbgcolor);
+			}
+		}
+
+		cursor_x += gxAdvance[gNum];
+	}
+	else
+	{
+		// Point code not in font so draw a rectangle and move on cursor
+		drawRect(cursor_x, cursor_y + gFont.maxAscent - gFont.ascent, gFont.spaceWidth, gFont.ascent, fg);
+		cursor_x += gFont.spaceWidth + 1;
+	}
+	bg_cursor_x = cursor_x;
+	last_cursor_x = cursor_x;
+
+	autoPresent();
+}
+
+/***************************************************************************************
+** Function name:           showFont
+** Description:             Page through all characters in font, td ms between screens
+***************************************************************************************/
+void TFT_eSPI::showFont(uint32_t td)
+{
+	if(!fontLoaded) return;
+
+	int16_t cursorX = width(); // Force start of new page to initialise cursor
+	int16_t cursorY = height();// for the first character
+	uint32_t timeDelay = 0;    // No delay before first page
+
+	fillScreen(textbgcolor);
+
+	for (uint16_t i = 0; i < gFont.gCount; i++)
+	{
+		// Check if this will need a new screen
+		if (cursorX + gdX[i] + gWidth[i] >= width())  {
+			cursorX = -gdX[i];
+
+			cursorY += gFont.yAdvance;
+			if (cursorY + gFont.maxAscent + gFont.descent >= height()) {
+				cursorX = -gdX[i];
+				cursorY = 0;
+				delay(timeDelay);
+				timeDelay = td;
+				fillScreen(textbgcolor);
+			}
+		}
+
+		setCursor(cursorX, cursorY);
+		drawGlyph(gUnicode[i]);
+		cursorX += gxAdvance[i];
+		yield();
+	}
+
+	delay(timeDelay);
+	fillScreen(textbgcolor);
+}
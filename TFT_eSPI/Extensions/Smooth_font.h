@@ -0,0 +1,64 @@
+ // Anti-aliased fonts in the Processing .vlw format. The font file is mapped into memory
+ // (or the font is a C array), the glyph metrics are read once and a hash index of the
+ // Unicode code points is built when the font is loaded. Glyph rows are drawn as spans,
+ // pixels at the glyph edges are blended with drawCoverage().
+
+ public:
+
+           // Load a font from a C array of the .vlw file
+  void     loadFont(const uint8_t array[]);
+           // Load a .vlw file, the extension is added if the name has none. There is no
+           // filing system on the host, the file is mapped from the disk whatever flash is
+  void     loadFont(String fontName, bool flash = true);
+  void     unloadFont( void );
+           // Index of the glyph of a code point, false if the font has no such glyph
+  bool     getUnicodeIndex(uint16_t unicode, uint16_t *index);
+
+  virtual void drawGlyph(uint16_t code);
+
+           // Show all the characters of the font, pausing td ms after each screen
+  void     showFont(uint32_t td);
+
+ // This is for the whole font
+  typedef struct
+  {
+    const uint8_t* gArray;           // Array start pointer
+    uint16_t  gCount;                // Total number of characters
+    uint16_t  yAdvance;              // Line advance
+    uint16_t  spaceWidth;            // Width of a space character
+    int16_t   ascent;                // Height of tallest glyph above baseline
+    int16_t   descent;               // Offset to bottom of tallest glyph below baseline
+    uint16_t  maxAscent;             // Maximum ascent found in font
+    uint16_t  maxDescent;            // Maximum descent found in font
+  } fontMetrics;
+
+  fontMetrics gFont = { nullptr, 0, 0, 0, 0, 0, 0, 0 };
+
+  // These are for the metrics for each individual glyph (so we don't need to read them for each glyph)
+  uint16_t* gUnicode = NULL;  //UTF-16 code, the codes are found through gIndex so do not need to be sorted
+  uint8_t*  gHeight = NULL;   //cheight
+  uint8_t*  gWidth = NULL;    //cwidth
+  uint8_t*  gxAdvance = NULL; //setWidth
+  int16_t*  gdY = NULL;       //topExtent
+  int8_t*   gdX = NULL;       //leftExtent
+  uint32_t* gBitmap = NULL;   //offset of the greyscale bitmap from gFont.gArray
+
+  bool     fontLoaded = false; // Flags when a anti-aliased font is loaded
+
+ protected:
+
+           // Blend the rows of glyph gNum with the top left corner at x,y. If _fillbg is set the
+           // transparent pixels from column bx on are filled with the text background colour
+  void     drawGlyphRows(uint16_t gNum, int32_t x, int32_t y, int32_t bx);
+
+ private:
+
+  bool     loadMetrics(uint32_t size);
+  uint32_t readInt32(void);
+
+  const uint8_t* fontPtr = nullptr; // Read position in the font
+  void*    fontMap = nullptr;       // Memory mapped font file, nullptr for a C array
+  size_t   fontMapSize = 0;
+
+  uint16_t* gIndex = NULL;    // Hash table of gNum + 1 for each code point, 0 for an empty slot
+  uint32_t  gIndexMask = 0;   // Table size - 1, the size is a power of 2
@@ -1059,13 +1059,7 @@ void  TFT_eSprite::pushImage(int32_t x, int32_t y, int32_t w, int32_t h, uint16_
     {
       while (dh--)
       {
-        // Fast copy with a 1 byte shift
-        memcpy(ptrs+1, ptro, (dw<<1) - 1);
-        // Now correct just the even numbered bytes
-        for (int32_t xp = 0; xp < (dw<<1); xp+=2)
-        {
-          ptrs[xp] = ptro[xp+1];;
-        }
+        swap565((uint16_t*)ptro, (uint16_t*)ptrs, dw);
         ptro += w<<1;
         ptrs += _iwidth<<1;
       }
@@ -1096,23 +1090,10 @@ void  TFT_eSprite::pushImage(int32_t x, int32_t y, int32_t w, int32_t h, uint16_
   }
   else if (_bpp == 8) // Plot a 16 bpp image into a 8 bpp Sprite
   {
-    uint16_t lastColor = 0;
-    uint8_t  color8    = 0;
     for (int32_t yp = dy; yp < dy + dh; yp++)
     {
-      int32_t xyw = x + y * _iwidth;
-      int32_t dxypw = dx + yp * w;
-      for (int32_t xp = dx; xp < dx + dw; xp++)
-      {
-        uint16_t color = data[dxypw++];
-        if (color != lastColor) {
-          // When data source is a sprite, the bytes are already swapped
-          if(!_swapBytes) color8 = (uint8_t)((color & 0xE0) | (color & 0x07)<<2 | (color & 0x1800)>>11);
-          else color8 = (uint8_t)((color & 0xE000)>>8 | (color & 0x0700)>>6 | (color & 0x0018)>>3);
-        }
-        lastColor = color;
-        _img8[xyw++] = color8;
-      }
+      // When data source is a sprite, the bytes are already swapped
+      color565to332(data + dx + yp * w, _img8 + x + y * _iwidth, dw, !_swapBytes);
       y++;
     }
   }
@@ -1191,18 +1172,13 @@ void  TFT_eSprite::pushImage(int32_t x, int32_t y, int32_t w, int32_t h, const u
 
   PI_CLIP;
 
+  // FLASH is read directly on the host, so whole rows are converted at once
   if (_bpp == 16) // Plot a 16 bpp image into a 16 bpp Sprite
   {
     for (int32_t yp = dy; yp < dy + dh; yp++)
     {
-      int32_t ox = x;
-      for (int32_t xp = dx; xp < dx + dw; xp++)
-      {
-        uint16_t color = pgm_read_word(data + xp + yp * w);
-        if(_swapBytes) color = color<<8 | color>>8;
-        _img[ox + y * _iwidth] = color;
-        ox++;
-      }
+      if(_swapBytes) swap565(data + dx + yp * w, _img + x + y * _iwidth, dw);
+      else memcpy(_img + x + y * _iwidth, data + dx + yp * w, dw << 1);
       y++;
     }
   }
@@ -1211,14 +1187,7 @@ void  TFT_eSprite::pushImage(int32_t x, int32_t y, int32_t w, int32_t h, const u
   {
     for (int32_t yp = dy; yp < dy + dh; yp++)
     {
-      int32_t ox = x;
-      for (int32_t xp = dx; xp < dx + dw; xp++)
-      {
-        uint16_t color = pgm_read_word(data + xp + yp * w);
-        if(_swapBytes) color = color<<8 | color>>8;
-        _img8[ox + y * _iwidth] = (uint8_t)((color & 0xE000)>>8 | (color & 0x0700)>>6 | (color & 0x0018)>>3);
-        ox++;
-      }
+      color565to332(data + dx + yp * w, _img8 + x + y * _iwidth, dw, _swapBytes);
       y++;
     }
   }
@@ -1703,55 +1672,10 @@ void TFT_eSprite::drawPixel(int32_t x, int32_t y, uint32_t color)
 ***************************************************************************************/
 void TFT_eSprite::drawLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint32_t color)
 {
-  if (!_created || _vpOoB) return;
-
-  //_xDatum and _yDatum Not added here, it is added by drawPixel & drawFastxLine
-
-  bool steep = abs(y1 - y0) > abs(x1 - x0);
-  if (steep) {
-    swap_coord(x0, y0);
-    swap_coord(x1, y1);
-  }
-
-  if (x0 > x1) {
-    swap_coord(x0, x1);
-    swap_coord(y0, y1);
-  }
-
-  int32_t dx = x1 - x0, dy = abs(y1 - y0);;
-
-  int32_t err = dx >> 1, ystep = -1, xs = x0, dlen = 0;
-
-  if (y0 < y1) ystep = 1;
+  if (!_created) return;
 
-  // Split into steep and not steep for FastH/V separation
-  if (steep) {
-    for (; x0 <= x1; x0++) {
-      dlen++;
-      err -= dy;
-      if (err < 0) {
-        err += dx;
-        if (dlen == 1) drawPixel(y0, xs, color);
-        else drawFastVLine(y0, xs, dlen, color);
-        dlen = 0; y0 += ystep; xs = x0 + 1;
-      }
-    }
-    if (dlen) drawFastVLine(y0, xs, dlen, color);
-  }
-  else
-  {
-    for (; x0 <= x1; x0++) {
-      dlen++;
-      err -= dy;
-      if (err < 0) {
-        err += dx;
-        if (dlen == 1) drawPixel(xs, y0, color);
-        else drawFastHLine(xs, y0, dlen, color);
-        dlen = 0; y0 += ystep; xs = x0 + 1;
-      }
-    }
-    if (dlen) drawFastHLine(xs, y0, dlen, color);
-  }
+  // Clipped to the viewport and drawn as runs with drawFastVLine() or drawSpans()
+  TFT_eSPI::drawLine(x0, y0, x1, y1, color);
 }
 
 
@@ -1879,6 +1803,101 @@ void TFT_eSprite::drawFastHLine(int32_t x, int32_t y, int32_t w, uint32_t color)
 }
 
 
+/***************************************************************************************
+** Function name:           drawCoverage
+** Description:             blend a colour onto a row with per pixel coverage
+***************************************************************************************/
+void TFT_eSprite::drawCoverage(int32_t x, int32_t y, uint32_t len, const uint8_t *alpha, uint32_t color, uint32_t bg_color)
+{
+  if (!_created || _vpOoB) return;
+
+  if (_bpp != 16)
+  {
+    for (uint32_t i = 0; i < len; i++)
+      if (alpha[i]) TFT_eSPI::drawPixel(x + i, y, color, alpha[i], bg_color);
+    return;
+  }
+
+  x+= _xDatum;
+  y+= _yDatum;
+
+  // Clipping
+  if ((y < _vpY) || (x >= _vpW) || (y >= _vpH)) return;
+
+  int64_t w = len;
+  if (x < _vpX)
+  {
+    if (w <= _vpX - x) return;
+    w -= _vpX - x;
+    alpha += _vpX - x;
+    x = _vpX;
+  }
+
+  if ((x + w) > _vpW) w = _vpW - x;
+
+  // Blend in native byte order, pixels with alpha 0 keep their colour
+  uint16_t *row = _img + _iwidth * y + x;
+  uint16_t buf[64];
+  while (w > 0)
+  {
+    uint32_t n = std::min<int64_t>(w, 64);
+    swap565(row, buf, n);
+    if (bg_color != 0x00FFFFFF)
+      for (uint32_t i = 0; i < n; i++) if (alpha[i]) buf[i] = bg_color;
+    alphaBlendMask(alpha, color, buf, buf, n);
+    swap565(buf, row, n);
+    row += n; alpha += n; w -= n;
+  }
+}
+
+
+/***************************************************************************************
+** Function name:           drawSpans
+** Description:             draw a list of horizontal spans
+***************************************************************************************/
+void TFT_eSprite::drawSpans(const fb_span_t *spans, uint32_t count, uint32_t color)
+{
+  for (uint32_t i = 0; i < count; i++)
+    drawFastHLine(spans[i].x0, spans[i].y, spans[i].x1 - spans[i].x0 + 1, color);
+}
+
+
+/***************************************************************************************
+** Function name:           pushRow
+** Description:             write a row of 16 bit colours
+***************************************************************************************/
+void TFT_eSprite::pushRow(int32_t x, int32_t y, uint32_t len, const uint16_t *colors)
+{
+  if (!_created || _vpOoB) return;
+
+  if (_bpp < 8)
+  {
+    for (uint32_t i = 0; i < len; i++) drawPixel(x + i, y, colors[i]);
+    return;
+  }
+
+  x+= _xDatum;
+  y+= _yDatum;
+
+  // Clipping
+  if ((y < _vpY) || (x >= _vpW) || (y >= _vpH)) return;
+
+  int64_t w = len;
+  if (x < _vpX)
+  {
+    if (w <= _vpX - x) return;
+    w -= _vpX - x;
+    colors += _vpX - x;
+    x = _vpX;
+  }
+
+  if ((x + w) > _vpW) w = _vpW - x;
+
+  if (_bpp == 16) swap565(colors, _img + _iwidth * y + x, w);
+  else color565to332(colors, _img8 + _iwidth * y + x, w);
+}
+
+
 /***************************************************************************************
 ** Function name:           fillRect
 ** Description:             draw a filled rectangle
@@ -1999,10 +2018,7 @@ void TFT_eSprite::drawChar(int32_t x, int32_t y, uint16_t c, uint32_t color, uin
 {
   if ( _vpOoB || !_created ) return;
 
-  if ((x >= _vpW - _xDatum) || // Clip right
-      (y >= _vpH - _yDatum))   // Clip bottom
-    return;
-
+  // Free font glyphs extend above and left of x,y, both renderers clip to the viewport
   if (c < 32) return;
 #ifdef LOAD_GLCD
 //>>>>>>>>>>>>>>>>>>
@@ -2011,61 +2027,7 @@ void TFT_eSprite::drawChar(int32_t x, int32_t y, uint16_t c, uint32_t color, uin
 #endif
 //>>>>>>>>>>>>>>>>>>
 
-  if (((x + 6 * size - 1) < (_vpX - _xDatum)) || // Clip left
-      ((y + 8 * size - 1) < (_vpY - _yDatum)))   // Clip top
-    return;
-
-  bool fillbg = (bg != color);
-
-  if ((size==1) && fillbg)
-  {
-    uint8_t column[6];
-    uint8_t mask = 0x1;
-
-    for (int8_t i = 0; i < 5; i++ ) column[i] = pgm_read_byte(font + (c * 5) + i);
-    column[5] = 0;
-
-    int8_t j, k;
-    for (j = 0; j < 8; j++) {
-      for (k = 0; k < 5; k++ ) {
-        if (column[k] & mask) {
-          drawPixel(x + k, y + j, color);
-        }
-        else {
-          drawPixel(x + k, y + j, bg);
-        }
-      }
-
-      mask <<= 1;
-
-      drawPixel(x + k, y + j, bg);
-    }
-  }
-  else
-  {
-    for (int8_t i = 0; i < 6; i++ ) {
-      uint8_t line;
-      if (i == 5)
-        line = 0x0;
-      else
-        line = pgm_read_byte(font + (c * 5) + i);
-
-      if (size == 1) // default size
-      {
-        for (int8_t j = 0; j < 8; j++) {
-          if (line & 0x1) drawPixel(x + i, y + j, color);
-          line >>= 1;
-        }
-      }
-      else {  // big size
-        for (int8_t j = 0; j < 8; j++) {
-          if (line & 0x1) fillRect(x + (i * size), y + (j * size), size, size, color);
-          else if (fillbg) fillRect(x + i * size, y + j * size, size, size, bg);
-          line >>= 1;
-        }
-      }
-    }
-  }
+  drawGLCDChar(x, y, c, color, bg, size);
 
 //>>>>>>>>>>>>>>>>>>>>>>>>>>>
 #ifdef LOAD_GFXFF
@@ -2075,60 +2037,7 @@ void TFT_eSprite::drawChar(int32_t x, int32_t y, uint16_t c, uint32_t color, uin
 #endif // LOAD_GLCD
 
 #ifdef LOAD_GFXFF
-    // Filter out bad characters not present in font
-    if ((c >= pgm_read_word(&gfxFont->first)) && (c <= pgm_read_word(&gfxFont->last )))
-    {
-//>>>>>>>>>>>>>>>>>>>>>>>>>>>
-
-      c -= pgm_read_word(&gfxFont->first);
-      GFXglyph *glyph  = &(((GFXglyph *)pgm_read_dword(&gfxFont->glyph))[c]);
-
-      uint8_t  w  = pgm_read_byte(&glyph->width),
-               h  = pgm_read_byte(&glyph->height);
-      int8_t   xo = pgm_read_byte(&glyph->xOffset),
-               yo = pgm_read_byte(&glyph->yOffset);
-
-      if (((x + xo + w * size - 1) < (_vpX - _xDatum)) || // Clip left
-          ((y + yo + h * size - 1) < (_vpY - _yDatum)))   // Clip top
-        return;
-
-      uint8_t  *bitmap = (uint8_t *)pgm_read_dword(&gfxFont->bitmap);
-      uint32_t bo = pgm_read_word(&glyph->bitmapOffset);
-
-      uint8_t  xx, yy, bits=0, bit=0;
-      //uint8_t  xa = pgm_read_byte(&glyph->xAdvance);
-      int16_t  xo16 = 0, yo16 = 0;
-
-      if(size > 1) {
-        xo16 = xo;
-        yo16 = yo;
-      }
-
-      uint16_t hpc = 0; // Horizontal foreground pixel count
-      for(yy=0; yy<h; yy++) {
-        for(xx=0; xx<w; xx++) {
-          if(bit == 0) {
-            bits = pgm_read_byte(&bitmap[bo++]);
-            bit  = 0x80;
-          }
-          if(bits & bit) hpc++;
-          else {
-            if (hpc) {
-              if(size == 1) drawFastHLine(x+xo+xx-hpc, y+yo+yy, hpc, color);
-              else fillRect(x+(xo16+xx-hpc)*size, y+(yo16+yy)*size, size*hpc, size, color);
-              hpc=0;
-            }
-          }
-          bit >>= 1;
-        }
-        // Draw pixels for this line as we are about to increment yy
-        if (hpc) {
-          if(size == 1) drawFastHLine(x+xo+xx-hpc, y+yo+yy, hpc, color);
-          else fillRect(x+(xo16+xx-hpc)*size, y+(yo16+yy)*size, size*hpc, size, color);
-          hpc=0;
-        }
-      }
-    }
+    drawFreeFontChar(x, y, c, color, size);
 #endif
 
 
@@ -2187,7 +2096,7 @@ int16_t TFT_eSprite::drawChar(uint16_t uniCode, int32_t x, int32_t y, uint8_t fo
     else {
       if((uniCode >= pgm_read_word(&gfxFont->first)) && (uniCode <= pgm_read_word(&gfxFont->last) )) {
         uint16_t   c2    = uniCode - pgm_read_word(&gfxFont->first);
-        GFXglyph *glyph = &(((GFXglyph *)pgm_read_dword(&gfxFont->glyph))[c2]);
+        GFXglyph *glyph = &(((GFXglyph *)pgm_read_ptr(&gfxFont->glyph))[c2]);
         return pgm_read_byte(&glyph->xAdvance) * textsize;
       }
       else {
@@ -2197,222 +2106,7 @@ int16_t TFT_eSprite::drawChar(uint16_t uniCode, int32_t x, int32_t y, uint8_t fo
 #endif
   }
 
-  if ((font>1) && (font<9) && ((uniCode < 32) || (uniCode > 127))) return 0;
-
-  int32_t width  = 0;
-  int32_t height = 0;
-  uint32_t flash_address = 0;
-  uniCode -= 32;
-
-#ifdef LOAD_FONT2
-  if (font == 2) {
-    flash_address = pgm_read_dword(&chrtbl_f16[uniCode]);
-    width = pgm_read_byte(widtbl_f16 + uniCode);
-    height = chr_hgt_f16;
-  }
-  #ifdef LOAD_RLE
-  else
-  #endif
-#endif
-
-#ifdef LOAD_RLE
-  {
-    if ((font>2) && (font<9)) {
-      flash_address = pgm_read_dword( (const void*)(pgm_read_dword( &(fontdata[font].chartbl ) ) + uniCode*sizeof(void *)) );
-      width = pgm_read_byte( (uint8_t *)pgm_read_dword( &(fontdata[font].widthtbl ) ) + uniCode );
-      height= pgm_read_byte( &fontdata[font].height );
-    }
-  }
-#endif
-
-  int32_t xd = x + _xDatum;
-  int32_t yd = y + _yDatum;
-
-  if ((xd + width * textsize < _vpX || xd >= _vpW) && (yd + height * textsize < _vpY || yd >= _vpH)) return width * textsize ;
-
-  int32_t w = width;
-  int32_t pX      = 0;
-  int32_t pY      = y;
-  uint8_t line = 0;
-  bool clip = xd < _vpX || xd + width  * textsize >= _vpW || yd < _vpY || yd + height * textsize >= _vpH;
-
-#ifdef LOAD_FONT2 // chop out code if we do not need it
-  if (font == 2) {
-    w = w + 6; // Should be + 7 but we need to compensate for width increment
-    w = w / 8;
-
-    for (int32_t i = 0; i < height; i++)
-    {
-      if (textcolor != textbgcolor) fillRect(x, pY, width * textsize, textsize, textbgcolor);
-
-      for (int32_t k = 0; k < w; k++)
-      {
-        line = pgm_read_byte((uint8_t *)flash_address + w * i + k);
-        if (line) {
-          if (textsize == 1) {
-            pX = x + k * 8;
-            if (line & 0x80) drawPixel(pX, pY, textcolor);
-            if (line & 0x40) drawPixel(pX + 1, pY, textcolor);
-            if (line & 0x20) drawPixel(pX + 2, pY, textcolor);
-            if (line & 0x10) drawPixel(pX + 3, pY, textcolor);
-            if (line & 0x08) drawPixel(pX + 4, pY, textcolor);
-            if (line & 0x04) drawPixel(pX + 5, pY, textcolor);
-            if (line & 0x02) drawPixel(pX + 6, pY, textcolor);
-            if (line & 0x01) drawPixel(pX + 7, pY, textcolor);
-          }
-          else {
-            pX = x + k * 8 * textsize;
-            if (line & 0x80) fillRect(pX, pY, textsize, textsize, textcolor);
-            if (line & 0x40) fillRect(pX + textsize, pY, textsize, textsize, textcolor);
-            if (line & 0x20) fillRect(pX + 2 * textsize, pY, textsize, textsize, textcolor);
-            if (line & 0x10) fillRect(pX + 3 * textsize, pY, textsize, textsize, textcolor);
-            if (line & 0x08) fillRect(pX + 4 * textsize, pY, textsize, textsize, textcolor);
-            if (line & 0x04) fillRect(pX + 5 * textsize, pY, textsize, textsize, textcolor);
-            if (line & 0x02) fillRect(pX + 6 * textsize, pY, textsize, textsize, textcolor);
-            if (line & 0x01) fillRect(pX + 7 * textsize, pY, textsize, textsize, textcolor);
-          }
-        }
-      }
-      pY += textsize;
-    }
-  }
-
-  #ifdef LOAD_RLE
-  else
-  #endif
-#endif  //FONT2
-
-#ifdef LOAD_RLE  //674 bytes of code
-  // Font is not 2 and hence is RLE encoded
-  {
-    w *= height; // Now w is total number of pixels in the character
-    int16_t color = textcolor;
-    if (_bpp == 16) color = (textcolor >> 8) | (textcolor << 8);
-    else if (_bpp == 8) color = ((textcolor & 0xE000)>>8 | (textcolor & 0x0700)>>6 | (textcolor & 0x0018)>>3);
-
-    int16_t bgcolor = textbgcolor;
-    if (_bpp == 16) bgcolor = (textbgcolor >> 8) | (textbgcolor << 8);
-    else if (_bpp == 8) bgcolor = ((textbgcolor & 0xE000)>>8 | (textbgcolor & 0x0700)>>6 | (textbgcolor & 0x0018)>>3);
-
-    if (textcolor == textbgcolor && !clip && _bpp != 1) {
-      int32_t px = 0, py = pY; // To hold character block start and end column and row values
-      int32_t pc = 0; // Pixel count
-      uint8_t np = textsize * textsize; // Number of pixels in a drawn pixel
-
-      uint8_t tnp = 0; // Temporary copy of np for while loop
-      uint8_t ts = textsize - 1; // Temporary copy of textsize
-      // 16 bit pixel count so maximum font size is equivalent to 180x180 pixels in area
-      // w is total number of pixels to plot to fill character block
-      while (pc < w) {
-        line = pgm_read_byte((uint8_t *)flash_address);
-        flash_address++;
-        if (line & 0x80) {
-          line &= 0x7F;
-          line++;
-          if (ts) {
-            px = xd + textsize * (pc % width); // Keep these px and py calculations outside the loop as they are slow
-            py = yd + textsize * (pc / width);
-          }
-          else {
-            px = xd + pc % width; // Keep these px and py calculations outside the loop as they are slow
-            py = yd + pc / width;
-          }
-          while (line--) { // In this case the while(line--) is faster
-            pc++; // This is faster than putting pc+=line before while()?
-            setWindow(px, py, px + ts, py + ts);
-
-            if (ts) {
-              tnp = np;
-              while (tnp--) writeColor(color);
-            }
-            else writeColor(color);
-
-            px += textsize;
-
-            if (px >= (xd + width * textsize)) {
-              px = xd;
-              py += textsize;
-            }
-          }
-        }
-        else {
-          line++;
-          pc += line;
-        }
-      }
-    }
-    else {
-      // Text colour != background and textsize = 1 and character is within viewport area
-      // so use faster drawing of characters and background using block write
-      if (textcolor != textbgcolor && textsize == 1 && !clip && _bpp != 1)
-      {
-        setWindow(xd, yd, xd + width - 1, yd + height - 1);
-
-        // Maximum font size is equivalent to 180x180 pixels in area
-        while (w > 0) {
-          line = pgm_read_byte((uint8_t *)flash_address++); // 8 bytes smaller when incrementing here
-          if (line & 0x80) {
-            line &= 0x7F;
-            line++; w -= line;
-            while (line--) writeColor(color);
-          }
-          else {
-            line++; w -= line;
-            while (line--) writeColor(bgcolor);
-          }
-        }
-      }
-      else
-      {
-        int32_t px = 0, py = 0;  // To hold character pixel coords
-        int32_t tx = 0, ty = 0;  // To hold character TFT pixel coords
-        int32_t pc = 0;          // Pixel count
-        int32_t pl = 0;          // Pixel line length
-        uint16_t pcol = 0;       // Pixel color
-        bool     pf = true;      // Flag for plotting
-        while (pc < w) {
-          line = pgm_read_byte((uint8_t *)flash_address);
-          flash_address++;
-          if (line & 0x80) { pcol = textcolor; line &= 0x7F; pf = true;}
-          else { pcol = textbgcolor; if (textcolor == textbgcolor) pf = false;}
-          line++;
-          px = pc % width;
-          tx = x + textsize * px;
-          py = pc / width;
-          ty = y + textsize * py;
-
-          pl = 0;
-          pc += line;
-          while (line--) {
-            pl++;
-            if ((px+pl) >= width) {
-              if (pf) fillRect(tx, ty, pl * textsize, textsize, pcol);
-              pl = 0;
-              px = 0;
-              tx = x;
-              py ++;
-              ty += textsize;
-            }
-          }
-          if (pl && pf) fillRect(tx, ty, pl * textsize, textsize, pcol);
-        }
-      }
-    }
-  }
-  // End of RLE font rendering
-#endif
-
-#if !defined (LOAD_FONT2) && !defined (LOAD_RLE)
-  // Stop warnings
-  flash_address = flash_address;
-  w = w;
-  pX = pX;
-  pY = pY;
-  line = line;
-  clip = clip;
-#endif
-
-  return width * textsize;    // x +
+  return drawCachedChar(uniCode, x, y, font);
 }
 
 
@@ -2426,8 +2120,6 @@ void TFT_eSprite::drawGlyph(uint16_t code)
 {
   uint16_t fg = textcolor;
   uint16_t bg = textbgcolor;
-  bool getBG  = false;
-  if (fg == bg) getBG = true;
 
   // Check if cursor has moved
   if (last_cursor_x != cursor_x)
@@ -2486,28 +2178,9 @@ void TFT_eSprite::drawGlyph(uint16_t code)
       if ( cursor_x == 0) cursor_x -= gdX[gNum];
     }
 
-    uint8_t* pbuffer = nullptr;
-    const uint8_t* gPtr = (const uint8_t*) gFont.gArray;
-
-#ifdef FONT_FS_AVAILABLE
-    if (fs_font) {
-      fontFile.seek(gBitmap[gNum], fs::SeekSet); // This is slow for a significant position shift!
-      pbuffer =  (uint8_t*)malloc(gWidth[gNum]);
-    }
-#endif
-
     int16_t cy = cursor_y + gFont.maxAscent - gdY[gNum];
     int16_t cx = cursor_x + gdX[gNum];
-
-    //  if (cx > width() && bg_cursor_x > width()) return;
-    //  if (cursor_y > height()) return;
-
-    int16_t  fxs = cx;
-    uint32_t fl = 0;
-    int16_t  bxs = cx;
-    uint32_t bl = 0;
-    int16_t  bx = 0;
-    uint8_t pixel = 0;
+    int16_t bx = 0;
 
     int16_t fillwidth  = 0;
     int16_t fillheight = 0;
@@ -2536,55 +2209,8 @@ void TFT_eSprite::drawGlyph(uint16_t code)
       }
     }
 
-    for (int32_t y = 0; y < gHeight[gNum]; y++)
-    {
-#ifdef FONT_FS_AVAILABLE
-      if (fs_font) {
-        fontFile.read(pbuffer, gWidth[gNum]);
-      }
-#endif
-
-      for (int32_t x = 0; x < gWidth[gNum]; x++)
-      {
-#ifdef FONT_FS_AVAILABLE
-        if (fs_font) pixel = pbuffer[x];
-        else
-#endif
-        pixel = pgm_read_byte(gPtr + gBitmap[gNum] + x + gWidth[gNum] * y);
-
-        if (pixel)
-        {
-          if (bl) { drawFastHLine( bxs, y + cy, bl, bg); bl = 0; }
-          if (pixel != 0xFF)
-          {
-            if (fl) {
-              if (fl==1) drawPixel(fxs, y + cy, fg);
-              else drawFastHLine( fxs, y + cy, fl, fg);
-              fl = 0;
-            }
-            if (getBG) bg = readPixel(x + cx, y + cy);
-            drawPixel(x + cx, y + cy, alphaBlend(pixel, fg, bg));
-          }
-          else
-          {
-            if (fl==0) fxs = x + cx;
-            fl++;
-          }
-        }
-        else
-        {
-          if (fl) { drawFastHLine( fxs, y + cy, fl, fg); fl = 0; }
-          if (_fillbg) {
-            if (x >= bx) {
-              if (bl==0) bxs = x + cx;
-              bl++;
-            }
-          }
-        }
-      }
-      if (fl) { drawFastHLine( fxs, y + cy, fl, fg); fl = 0; }
-      if (bl) { drawFastHLine( bxs, y + cy, bl, bg); bl = 0; }
-    }
+    // Without a background colour the edge pixels are blended with the sprite pixels
+    drawGlyphRows(gNum, cx, cy, bx);
 
     // Fill area below glyph
     if (fillwidth > 0) {
@@ -2594,7 +2220,6 @@ void TFT_eSprite::drawGlyph(uint16_t code)
       }
     }
 
-    if (pbuffer) free(pbuffer);
     cursor_x += gxAdvance[gNum];
 
     if (newSprite)
@@ -161,6 +161,11 @@ class TFT_eSprite : public TFT_eSPI {
 
  protected:
 
+           // Blend a coverage mask row, 16 bit Sprites are blended in place
+  void     drawCoverage(int32_t x, int32_t y, uint32_t len, const uint8_t *alpha, uint32_t color, uint32_t bg_color);
+  void     pushRow(int32_t x, int32_t y, uint32_t len, const uint16_t *colors);
+  void     drawSpans(const fb_span_t *spans, uint32_t count, uint32_t color);
+
   uint8_t  _bpp;     // bits per pixel (1, 4, 8 or 16)
   uint16_t *_img;    // pointer to 16 bit sprite
   uint8_t  *_img8;   // pointer to  1 and 8 bit sprite frame 1 or frame 2
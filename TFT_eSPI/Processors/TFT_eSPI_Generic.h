@@ -0,0 +1,7 @@
+        ////////////////////////////////////////////////////
+        //  TFT_eSPI generic driver functions (SDL / x86) //
+        ////////////////////////////////////////////////////
+
+// There is no bus, pixels sent to the TFT are written to the address window
+// of the frame buffer set by setWindow()
+#define tft_Write_16(C) pushColor(C)
@@ -21,8 +21,17 @@
  ****************************************************************************/
 #include "TFT_eSPI.h"
 
+#ifndef TFT_HEADLESS
 #include <SDL.h>
+#include "Extensions/Presenter.h"
+#endif
+#include "Extensions/DMA.h"
 #include <assert.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include <array>
+#include <chrono>
 #include <stdexcept>
 
 // Clipping macro for pushImage
@@ -46,10 +55,49 @@
 	\
 	if (dw < 1 || dh < 1) return;
 
+// Account the bus cost of a drawing call and the calls it makes to the named primitive
+#define BUS_PRIMITIVE(name) bus_scope_t busScope(this, name)
+
+// Copy a w x h block turned clockwise by turns quarter turns (the copy is h x w for odd turns)
+// and XOR the pixels with invert. Strides are in pixels. The destination is written row by row.
+static void rotateBlock(const uint16_t *src, int32_t srcStride, int32_t w, int32_t h,
+								uint16_t *dst, int32_t dstStride, uint8_t turns, uint16_t invert)
+{
+	int32_t dw = turns & 1 ? h : w;
+	int32_t dh = turns & 1 ? w : h;
+
+	for (int32_t y = 0; y < dh; y++, dst += dstStride) {
+		switch (turns & 3) {
+			case 0: // Source row y
+				for (int32_t x = 0; x < dw; x++) dst[x] = src[y * srcStride + x] ^ invert;
+				break;
+			case 1: // Source column y, bottom up
+				for (int32_t x = 0; x < dw; x++) dst[x] = src[(h - 1 - x) * srcStride + y] ^ invert;
+				break;
+			case 2: // Source row h - 1 - y, right to left
+				for (int32_t x = 0; x < dw; x++) dst[x] = src[(h - 1 - y) * srcStride + w - 1 - x] ^ invert;
+				break;
+			case 3: // Source column w - 1 - y, top down
+				for (int32_t x = 0; x < dw; x++) dst[x] = src[x * srcStride + w - 1 - y] ^ invert;
+				break;
+		}
+	}
+}
 
 
 #include "Extensions/Button.cpp"
 #include "Extensions/Sprite.cpp"
+#include "Extensions/BusCost.cpp"
+#include "Extensions/Color.cpp"
+#include "Extensions/AntiAlias.cpp"
+#include "Extensions/GlyphCache.cpp"
+#ifdef SMOOTH_FONT
+#include "Extensions/Smooth_font.cpp"
+#endif
+#include "Extensions/DMA.cpp"
+#ifndef TFT_HEADLESS
+#include "Extensions/Presenter.cpp"
+#endif
 
 TFT_eSPI::TFT_eSPI(int16_t w, int16_t h)
 {
@@ -68,6 +116,7 @@ TFT_eSPI::TFT_eSPI(int16_t w, int16_t h)
 	padX        = 0;                  // No padding
 
 	_fillbg    = false;   // Smooth font only at the moment, force text background fill
+	_textRecord = nullptr; // Set while drawString() adds a string to the text run cache
 
 	isDigits   = false;   // No bounding box adjustment
 	textwrapX  = true;    // Wrap text at end of line when using print stream
@@ -77,6 +126,28 @@ TFT_eSPI::TFT_eSPI(int16_t w, int16_t h)
 
 	_swapBytes = false;   // Do not swap colour bytes by default
 
+	_fb = nullptr;        // Frame buffer is allocated by init()
+	_headless = false;    // Decided by init()
+	_invert = false;
+	_presenter = nullptr; // Created by init() unless headless
+	_dma = nullptr;       // Created by initDMA()
+	_dmaStats = {};
+	_damageCount = 0;
+	_damageLast = 0;
+
+	_presentMode = PRESENT_ON_LOOP;
+	_presentInterval = 1000000 / 60;
+	_lastPresent = 0;
+
+	_busPrimitive = nullptr;
+	_busSite = nullptr;
+	_busAsync = false;
+	resetBusStats();
+
+	_busThrottle = false;
+	_busClock = _busTick = 0;
+	_busPeriod = 1000000000 / 60;
+
 	locked = true;           // Transaction mutex lock flag to ensure begin/endTranaction pairing
 	inTransaction = false;   // Flag to prevent multiple sequential functions to keep bus access open
 	lockTransaction = false; // start/endWrite lock flag to allow sketch to keep SPI bus access open
@@ -85,10 +156,6 @@ TFT_eSPI::TFT_eSPI(int16_t w, int16_t h)
 	_cp437    = true;     // Legacy GLCD font bug fix
 	_utf8     = true;     // UTF8 decoding enabled
 
-#if defined (FONT_FS_AVAILABLE) && defined (SMOOTH_FONT)
-	fs_font  = true;     // Smooth font filing system or array (fs_font = false) flag
-#endif
-
 #if defined (ESP32) && defined (CONFIG_SPIRAM_SUPPORT)
 	if (psramFound()) _psram_enable = true; // Enable the use of PSRAM (if available)
 	else
@@ -98,6 +165,9 @@ TFT_eSPI::TFT_eSPI(int16_t w, int16_t h)
 	addr_row = 0xFFFF;  // drawPixel command length optimiser
 	addr_col = 0xFFFF;  // drawPixel command length optimiser
 
+	win_xs = win_ys = win_xe = win_ye = 0;
+	win_x = win_y = 0;
+
 	_xPivot = 0;
 	_yPivot = 0;
 
@@ -141,34 +211,66 @@ TFT_eSPI::TFT_eSPI(int16_t w, int16_t h)
 #endif
 }
 
-static SDL_Window *SDL_WINDOW;
-static SDL_Renderer *SDL_RENDERER;
+// Headless mode is selected at build time (TFT_HEADLESS) or with the
+// TFT_ESPI_HEADLESS environment variable set to anything but "0"
+static bool headlessRequested()
+{
+#ifdef TFT_HEADLESS
+	return true;
+#else
+	const char *env = getenv("TFT_ESPI_HEADLESS");
+	return env && *env && strcmp(env, "0") != 0;
+#endif
+}
 
-void setSDLColor(uint32_t color)
+// Wall clock used for frame pacing
+static uint64_t presentClock()
 {
-	uint8_t r = (color >> 8) & 0xF8; r |= (r >> 5);
-	uint8_t g = (color >> 3) & 0xFC; g |= (g >> 6);
-	uint8_t b = (color << 3) & 0xF8; b |= (b >> 5);
+	auto now = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+}
 
-	SDL_SetRenderDrawColor(SDL_RENDERER, r, g, b, 255);
+// Called by main() after every pass of the sketch loop()
+static void loopEndPresent(void *arg)
+{
+	static_cast<TFT_eSPI *>(arg)->loop();
 }
 
 TFT_eSPI::~TFT_eSPI()
 {
-	SDL_DestroyWindow(SDL_WINDOW);
-	SDL_DestroyRenderer(SDL_RENDERER);
+#ifdef SMOOTH_FONT
+	if (fontLoaded) unloadFont(); // Frees the glyph metrics and unmaps the font file
+#endif
+
+	// Only an initialised display owns the SDL objects (Sprites never call init())
+	if (!_fb)
+		return;
+
+	detachLoopEndCallback(loopEndPresent, this);
+
+	// The DMA engine writes to the frame buffer
+	delete _dma;
+#ifndef TFT_HEADLESS
+	delete _presenter;
+#endif
+	delete [] _fb;
 }
 
 void TFT_eSPI::init(uint8_t tc)
 {
-	if (SDL_Init(SDL_INIT_EVERYTHING) != 0){
-		throw std::runtime_error("SDL_Init failed: " + std::string(SDL_GetError()));
-	}
-
-	SDL_WINDOW = SDL_CreateWindow("Arduino", SDL_WINDOWPOS_CENTERED,
-											SDL_WINDOWPOS_CENTERED, _init_width, _init_height, 0);
+	if (!_fb) {
+		// A headless display has no window or renderer, only the frame buffer
+		_headless = headlessRequested();
+#ifndef TFT_HEADLESS
+		if (!_headless)
+			_presenter = new TFT_ePresenter(TFT_MOUNT_ROTATION & 1 ? _init_height : _init_width,
+														 TFT_MOUNT_ROTATION & 1 ? _init_width : _init_height);
+#endif
 
-	SDL_RENDERER = SDL_CreateRenderer(SDL_WINDOW, -1, 0);
+		_fb = new uint16_t[_init_width * _init_height]();
+		addDamage(0, 0, _init_width, _init_height);
+		attachLoopEndCallback(loopEndPresent, this);
+	}
 
 	setRotation(rotation);
 }
@@ -180,20 +282,71 @@ void TFT_eSPI::begin(uint8_t tc)
 
 void TFT_eSPI::loop()
 {
-	SDL_Event event;
-	SDL_PollEvent(&event);
-	/*while(SDL_PollEvent(&event)) {
-		if (event.type == SDL_QUIT) {
-			throw std::runtime_error("exit");
-		} else if (event.type == SDL_KEYUP) {
-			if (event.key.keysym.sym == SDLK_ESCAPE)
-				throw std::runtime_error("exit");
-		}
-	}*/
+	if (_presentMode == PRESENT_ON_LOOP)
+		present();
+	else if (_presentMode == PRESENT_MAX_FPS)
+		autoPresent();
+}
+
+void TFT_eSPI::setPresentMode(uint8_t mode, uint16_t fps)
+{
+	_presentMode = mode;
+	if (fps > 0)
+		_presentInterval = 1000000 / fps;
+}
+
+uint8_t TFT_eSPI::getPresentMode()
+{
+	return _presentMode;
+}
+
+bool TFT_eSPI::isHeadless()
+{
+	return _headless;
+}
+
+void TFT_eSPI::present()
+{
+	busFrame();
+
+	// Show the frame when the device would have finished sending it
+	if (_busThrottle) busWait();
+
+	submitFrame();
+}
+
+void TFT_eSPI::submitFrame()
+{
+	// Nothing has changed since the last present
+	if (!_fb || !mergeDamage())
+		return;
+
+	// The damage of a DMA transfer is recorded when it starts
+	if (_dma) _dma->sync();
+
+	// Hand the frame over to the presenter thread, which uploads and shows it
+#ifndef TFT_HEADLESS
+	if (_presenter)
+		_presenter->submit(_fb, _width, _height, _damage, _damageCount, (rotation - TFT_MOUNT_ROTATION) & 3, _invert);
+#endif
+	_damageCount = 0;
+
+	_lastPresent = presentClock();
+}
+
+void TFT_eSPI::autoPresent()
+{
+	if (_presentMode != PRESENT_MAX_FPS || !_fb)
+		return;
+
+	if (presentClock() - _lastPresent >= _presentInterval)
+		present();
 }
 
 void TFT_eSPI::drawPixel(int32_t x, int32_t y, uint32_t color)
 {
+	BUS_PRIMITIVE("drawPixel");
+
 	if (_vpOoB) return;
 
 	x+= _xDatum;
@@ -202,45 +355,244 @@ void TFT_eSPI::drawPixel(int32_t x, int32_t y, uint32_t color)
 	// Range checking
 	if ((x < _vpX) || (y < _vpY) ||(x >= _vpW) || (y >= _vpH)) return;
 
-#ifdef CGRAM_OFFSET
-	x+=colstart;
-	y+=rowstart;
-#endif
+	dmaWait();
+	_fb[y * _width + x] = color;
 
-	setSDLColor(color);
-	SDL_RenderDrawPoint(SDL_RENDERER, x, y);
+	busPixel(x, y);
+	addDamage(x, y, 1, 1);
 
-	SDL_RenderPresent(SDL_RENDERER);
+	autoPresent();
 }
 
+#ifdef LOAD_GLCD
+// Runs of set bits in a row of a character, bit n is column n
+typedef struct { uint8_t count, x0[4], x1[4]; } glcd_runs_t;
+
+static const glcd_runs_t *glcdRuns()
+{
+	static const std::array<glcd_runs_t, 256> runs = [] {
+		std::array<glcd_runs_t, 256> t = {};
+		for (int m = 0; m < 256; m++) {
+			for (int x = 0; x < 8; x++) {
+				if (!(m >> x & 1)) continue;
+				glcd_runs_t &r = t[m];
+				if (x && (m >> (x - 1) & 1)) r.x1[r.count - 1] = x;
+				else { r.x0[r.count] = r.x1[r.count] = x; r.count++; }
+			}
+		}
+		return t;
+	}();
+	return runs.data();
+}
+
+// The 5x8 font is stored in columns, each row of the 6 pixel wide cell is a bit mask that
+// the lookup table turns into spans. The background spans are the runs of the inverted mask.
+void TFT_eSPI::drawGLCDChar(int32_t x, int32_t y, uint16_t c, uint32_t color, uint32_t bg, uint8_t size)
+{
+	if ((c >= sizeof(font) / 5) || !size) return;
+
+	int32_t vx0 = _vpX - _xDatum, vx1 = _vpW - _xDatum;
+	int32_t vy0 = _vpY - _yDatum, vy1 = _vpH - _yDatum;
+	if ((x >= vx1) || (y >= vy1) || (x + 6 * size <= vx0) || (y + 8 * size <= vy0)) return;
+
+	uint8_t rows[8] = {};
+	for (int32_t i = 0; i < 5; i++) {
+		uint8_t column = pgm_read_byte(font + c * 5 + i);
+		for (int32_t j = 0; j < 8; j++) rows[j] |= ((column >> j) & 1) << i;
+	}
+
+	const glcd_runs_t *runs = glcdRuns();
+	bool fillbg = (bg != color);
+
+	fb_span_t fgSpans[64], bgSpans[64];
+	uint32_t fgCount = 0, bgCount = 0;
+	auto add = [&](fb_span_t *spans, uint32_t &count, const glcd_runs_t &r, int32_t yr, uint32_t col) {
+		for (uint8_t i = 0; i < r.count; i++) {
+			spans[count++] = { x + r.x0[i] * size, x + (r.x1[i] + 1) * size - 1, yr };
+			if (count == 64) { textSpans(spans, count, col); count = 0; }
+		}
+	};
+
+	for (int32_t j = 0; j < 8; j++) {
+		for (int32_t r = 0; r < size; r++) {
+			int32_t yr = y + j * size + r;
+			if ((yr < vy0) || (yr >= vy1)) continue;
+			add(fgSpans, fgCount, runs[rows[j]], yr, color);
+			if (fillbg) add(bgSpans, bgCount, runs[~rows[j] & 0x3F], yr, bg);
+		}
+	}
+
+	if (fgCount) textSpans(fgSpans, fgCount, color);
+	if (bgCount) textSpans(bgSpans, bgCount, bg);
+}
+#endif
+
 void TFT_eSPI::drawChar(int32_t x, int32_t y, uint16_t c, uint32_t color, uint32_t bg, uint8_t size)
 {
-	assert(false && "drawChar not implemented yet");
+	BUS_PRIMITIVE("drawChar");
+
+	if (_vpOoB || (c < 32)) return;
+
+#ifdef LOAD_GFXFF
+	if (gfxFont) {
+		drawFreeFontChar(x, y, c, color, size);
+		autoPresent();
+		return;
+	}
+#endif
+
+#ifdef LOAD_GLCD
+	drawGLCDChar(x, y, c, color, bg, size);
+	autoPresent();
+#endif
+}
+
+// Bresenham line walked along its major axis u, v is the minor axis. Starting at (u, v) with
+// error term err, n pixels are in the clip area.
+struct line_clip_t {
+	bool    steep;
+	int32_t u, v, vstep, dx, dy, err, n;
+};
+
+// Clip a line to the area x0 <= x < x1, y0 <= y < y1 before it is walked. The pixels are the
+// ones of the whole line: the first and last step in the area follow from the error term
+// in closed form, like a Liang-Barsky clip in integer steps.
+static bool clipLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, const fb_rect_t &clip, line_clip_t &l)
+{
+	l.steep = abs(y1 - y0) > abs(x1 - x0);
+	int32_t umin = clip.x0, umax = clip.x1 - 1, vmin = clip.y0, vmax = clip.y1 - 1;
+	if (l.steep) {
+		swap_coord(x0, y0);
+		swap_coord(x1, y1);
+		swap_coord(umin, vmin);
+		swap_coord(umax, vmax);
+	}
+
+	if (x0 > x1) {
+		swap_coord(x0, x1);
+		swap_coord(y0, y1);
+	}
+
+	if ((x1 < umin) || (x0 > umax) || (std::max(y0, y1) < vmin) || (std::min(y0, y1) > vmax)) return false;
+
+	int64_t dx = x1 - x0, dy = abs(y1 - y0), h = dx >> 1;
+	l.vstep = (y0 < y1) ? 1 : -1;
+
+	// Steps k along u in the clip area, then the minor steps m in it: after k steps
+	// m = ceil((k * dy - h) / dx) (at least 0), so m >= a from k > ((a - 1) * dx + h) / dy
+	// and m <= b up to k <= (b * dx + h) / dy
+	int64_t k0 = std::max<int64_t>(0, umin - x0), k1 = std::min<int64_t>(dx, umax - x0);
+	int64_t a = (l.vstep > 0) ? vmin - y0 : y0 - vmax;
+	int64_t b = (l.vstep > 0) ? vmax - y0 : y0 - vmin;
+	if (dy) {
+		if (a > 0) k0 = std::max(k0, ((a - 1) * dx + h) / dy + 1);
+		k1 = std::min(k1, (b * dx + h) / dy);
+	}
+	if (k0 > k1) return false;
+
+	int64_t m = (k0 * dy > h) ? (k0 * dy - h + dx - 1) / dx : 0;
+	l.u   = x0 + k0;
+	l.v   = y0 + l.vstep * m;
+	l.dx  = dx;
+	l.dy  = dy;
+	l.err = h - k0 * dy + m * dx;
+	l.n   = k1 - k0 + 1;
+	return true;
 }
 
-void TFT_eSPI::drawLine(int32_t xs, int32_t ys, int32_t xe, int32_t ye, uint32_t color)
+void TFT_eSPI::drawLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint32_t color)
 {
+	BUS_PRIMITIVE("drawLine");
+
 	if (_vpOoB) return;
 
-	setSDLColor(color);
-	SDL_RenderDrawLine(SDL_RENDERER, xs, ys, xe, ye);
-	SDL_RenderPresent(SDL_RENDERER);
+	// Rows and columns are clipped by drawFastXLine
+	if (y0 == y1) {
+		if (x0 > x1) swap_coord(x0, x1);
+		drawFastHLine(x0, y0, x1 - x0 + 1, color);
+	}
+	else if (x0 == x1) {
+		if (y0 > y1) swap_coord(y0, y1);
+		drawFastVLine(x0, y0, y1 - y0 + 1, color);
+	}
+	else {
+		// The viewport relative to the datum, the line is not offset
+		fb_rect_t clip = { _vpX - _xDatum, _vpY - _yDatum, _vpW - _xDatum, _vpH - _yDatum };
+		line_clip_t l;
+		if (!clipLine(x0, y0, x1, y1, clip, l)) return;
+
+		// A run ends when the minor axis steps, steep lines are drawn as vertical runs and
+		// the others as rows of spans
+		fb_span_t spans[64];
+		uint32_t count = 0;
+		int32_t us = l.u;
+		for (; l.n--; l.u++) {
+			l.err -= l.dy;
+			if ((l.err >= 0) && l.n) continue;
+
+			if (l.steep) drawFastVLine(l.v, us, l.u - us + 1, color);
+			else {
+				spans[count++] = { us, l.u, l.v };
+				if (count == 64) { drawSpans(spans, count, color); count = 0; }
+			}
+			l.v += l.vstep; l.err += l.dx; us = l.u + 1;
+		}
+		if (count) drawSpans(spans, count, color);
+	}
+
+	autoPresent();
 }
 
 void TFT_eSPI::drawFastVLine(int32_t x, int32_t y, int32_t h, uint32_t color)
 {
-	setSDLColor(color);
-	SDL_RenderDrawLine(SDL_RENDERER, x, y, x, y + h);
+	BUS_PRIMITIVE("drawFastVLine");
+
+	if (_vpOoB) return;
+
+	x+= _xDatum;
+	y+= _yDatum;
+
+	// Clipping
+	if ((x < _vpX) || (x >= _vpW) || (y >= _vpH)) return;
+
+	if (y < _vpY) { h += y - _vpY; y = _vpY; }
+
+	if (h > _vpH - y) h = _vpH - y;
+
+	if (h < 1) return;
+
+	fillFramebuffer(x, y, 1, h, color);
+
+	autoPresent();
 }
 
 void TFT_eSPI::drawFastHLine(int32_t x, int32_t y, int32_t w, uint32_t color)
 {
-	setSDLColor(color);
-	SDL_RenderDrawLine(SDL_RENDERER, x, y, x + w, y);
+	BUS_PRIMITIVE("drawFastHLine");
+
+	if (_vpOoB) return;
+
+	x+= _xDatum;
+	y+= _yDatum;
+
+	// Clipping
+	if ((y < _vpY) || (x >= _vpW) || (y >= _vpH)) return;
+
+	if (x < _vpX) { w += x - _vpX; x = _vpX; }
+
+	if (w > _vpW - x) w = _vpW - x;
+
+	if (w < 1) return;
+
+	fillFramebuffer(x, y, w, 1, color);
+
+	autoPresent();
 }
 
 void TFT_eSPI::fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color)
 {
+	BUS_PRIMITIVE("fillRect");
+
 	if (_vpOoB)
 		return;
 
@@ -269,11 +621,9 @@ void TFT_eSPI::fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t col
 	//Serial.print(" x=");Serial.print( y);Serial.print(", y=");Serial.print( y);
 	//Serial.print(", w=");Serial.print(w);Serial.print(", h=");Serial.println(h);
 
-	setSDLColor(color);
-	SDL_Rect rect = {x, y, w, h};
-	SDL_RenderFillRect(SDL_RENDERER, &rect);
+	fillFramebuffer(x, y, w, h, color);
 
-	SDL_RenderPresent(SDL_RENDERER);
+	autoPresent();
 
 	/*begin_tft_write();
 
@@ -286,6 +636,8 @@ void TFT_eSPI::fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t col
 
 int16_t TFT_eSPI::drawChar(uint16_t uniCode, int32_t x, int32_t y, uint8_t font)
 {
+	BUS_PRIMITIVE("drawChar");
+
 	if (_vpOoB || !uniCode)
 		return 0;
 
@@ -313,7 +665,7 @@ int16_t TFT_eSPI::drawChar(uint16_t uniCode, int32_t x, int32_t y, uint8_t font)
 		else {
 			if((uniCode >= pgm_read_word(&gfxFont->first)) && (uniCode <= pgm_read_word(&gfxFont->last) )) {
 				uint16_t   c2    = uniCode - pgm_read_word(&gfxFont->first);
-				GFXglyph *glyph = &(((GFXglyph *)pgm_read_dword(&gfxFont->glyph))[c2]);
+				GFXglyph *glyph = &(((GFXglyph *)pgm_read_ptr(&gfxFont->glyph))[c2]);
 				return pgm_read_byte(&glyph->xAdvance) * textsize;
 			}
 			else {
@@ -323,249 +675,7 @@ int16_t TFT_eSPI::drawChar(uint16_t uniCode, int32_t x, int32_t y, uint8_t font)
 #endif
 	}
 
-	if ((font>1) && (font<9) && ((uniCode < 32) || (uniCode > 127))) return 0;
-
-	int32_t width  = 0;
-	int32_t height = 0;
-	uint32_t flash_address = 0;
-	uniCode -= 32;
-
-#ifdef LOAD_FONT2
-	if (font == 2) {
-		flash_address = pgm_read_dword(&chrtbl_f16[uniCode]);
-		width = pgm_read_byte(widtbl_f16 + uniCode);
-		height = chr_hgt_f16;
-	}
-#ifdef LOAD_RLE
-	else
-#endif
-#endif
-
-#ifdef LOAD_RLE
-	{
-		if ((font>2) && (font<9)) {
-			flash_address = pgm_read_dword( (const void*)(pgm_read_dword( &(fontdata[font].chartbl ) ) + uniCode*sizeof(void *)) );
-			width = pgm_read_byte( (uint8_t *)pgm_read_dword( &(fontdata[font].widthtbl ) ) + uniCode );
-			height= pgm_read_byte( &fontdata[font].height );
-		}
-	}
-#endif
-
-	int32_t xd = x + _xDatum;
-	int32_t yd = y + _yDatum;
-
-	if ((xd + width * textsize < _vpX || xd >= _vpW) && (yd + height * textsize < _vpY || yd >= _vpH)) return width * textsize ;
-
-	int32_t w = width;
-	int32_t pX      = 0;
-	int32_t pY      = y;
-	uint8_t line = 0;
-	bool clip = xd < _vpX || xd + width  * textsize >= _vpW || yd < _vpY || yd + height * textsize >= _vpH;
-
-#ifdef LOAD_FONT2 // chop out code if we do not need it
-	if (font == 2) {
-		w = w + 6; // Should be + 7 but we need to compensate for width increment
-		w = w / 8;
-
-		if (textcolor == textbgcolor || textsize != 1 || clip) {
-			//begin_tft_write();          // Sprite class can use this function, avoiding begin_tft_write()
-			inTransaction = true;
-
-			for (int32_t i = 0; i < height; i++) {
-				if (textcolor != textbgcolor) fillRect(x, pY, width * textsize, textsize, textbgcolor);
-
-				for (int32_t k = 0; k < w; k++) {
-					line = pgm_read_byte((uint8_t *)flash_address + w * i + k);
-					if (line) {
-						if (textsize == 1) {
-							pX = x + k * 8;
-							if (line & 0x80) drawPixel(pX, pY, textcolor);
-							if (line & 0x40) drawPixel(pX + 1, pY, textcolor);
-							if (line & 0x20) drawPixel(pX + 2, pY, textcolor);
-							if (line & 0x10) drawPixel(pX + 3, pY, textcolor);
-							if (line & 0x08) drawPixel(pX + 4, pY, textcolor);
-							if (line & 0x04) drawPixel(pX + 5, pY, textcolor);
-							if (line & 0x02) drawPixel(pX + 6, pY, textcolor);
-							if (line & 0x01) drawPixel(pX + 7, pY, textcolor);
-						}
-						else {
-							pX = x + k * 8 * textsize;
-							if (line & 0x80) fillRect(pX, pY, textsize, textsize, textcolor);
-							if (line & 0x40) fillRect(pX + textsize, pY, textsize, textsize, textcolor);
-							if (line & 0x20) fillRect(pX + 2 * textsize, pY, textsize, textsize, textcolor);
-							if (line & 0x10) fillRect(pX + 3 * textsize, pY, textsize, textsize, textcolor);
-							if (line & 0x08) fillRect(pX + 4 * textsize, pY, textsize, textsize, textcolor);
-							if (line & 0x04) fillRect(pX + 5 * textsize, pY, textsize, textsize, textcolor);
-							if (line & 0x02) fillRect(pX + 6 * textsize, pY, textsize, textsize, textcolor);
-							if (line & 0x01) fillRect(pX + 7 * textsize, pY, textsize, textsize, textcolor);
-						}
-					}
-				}
-				pY += textsize;
-			}
-
-			inTransaction = lockTransaction;
-			end_tft_write();
-		}
-		else { // Faster drawing of characters and background using block write
-
-			begin_tft_write();
-
-			setWindow(xd, yd, xd + width - 1, yd + height - 1);
-
-			uint8_t mask;
-			for (int32_t i = 0; i < height; i++) {
-				pX = width;
-				for (int32_t k = 0; k < w; k++) {
-					line = pgm_read_byte((uint8_t *) (flash_address + w * i + k) );
-					mask = 0x80;
-					while (mask && pX) {
-						if (line & mask) {tft_Write_16(textcolor);}
-						else {tft_Write_16(textbgcolor);}
-						pX--;
-						mask = mask >> 1;
-					}
-				}
-				if (pX) {tft_Write_16(textbgcolor);}
-			}
-
-			end_tft_write();
-		}
-	}
-
-#ifdef LOAD_RLE
-	else
-#endif
-#endif  //FONT2
-
-#ifdef LOAD_RLE  //674 bytes of code
-		// Font is not 2 and hence is RLE encoded
-	{
-		begin_tft_write();
-		inTransaction = true;
-
-		w *= height; // Now w is total number of pixels in the character
-		if (textcolor == textbgcolor && !clip) {
-
-			int32_t px = 0, py = pY; // To hold character block start and end column and row values
-			int32_t pc = 0; // Pixel count
-			uint8_t np = textsize * textsize; // Number of pixels in a drawn pixel
-
-			uint8_t tnp = 0; // Temporary copy of np for while loop
-			uint8_t ts = textsize - 1; // Temporary copy of textsize
-			// 16 bit pixel count so maximum font size is equivalent to 180x180 pixels in area
-			// w is total number of pixels to plot to fill character block
-			while (pc < w) {
-				line = pgm_read_byte((uint8_t *)flash_address);
-				flash_address++;
-				if (line & 0x80) {
-					line &= 0x7F;
-					line++;
-					if (ts) {
-						px = xd + textsize * (pc % width); // Keep these px and py calculations outside the loop as they are slow
-						py = yd + textsize * (pc / width);
-					}
-					else {
-						px = xd + pc % width; // Keep these px and py calculations outside the loop as they are slow
-						py = yd + pc / width;
-					}
-					while (line--) { // In this case the while(line--) is faster
-						pc++; // This is faster than putting pc+=line before while()?
-						setWindow(px, py, px + ts, py + ts);
-
-						if (ts) {
-							tnp = np;
-							while (tnp--) {tft_Write_16(textcolor);}
-						}
-						else {tft_Write_16(textcolor);}
-						px += textsize;
-
-						if (px >= (xd + width * textsize)) {
-							px = xd;
-							py += textsize;
-						}
-					}
-				}
-				else {
-					line++;
-					pc += line;
-				}
-			}
-		}
-		else {
-			// Text colour != background and textsize = 1 and character is within viewport area
-			// so use faster drawing of characters and background using block write
-			if (textcolor != textbgcolor && textsize == 1 && !clip)
-			{
-				setWindow(xd, yd, xd + width - 1, yd + height - 1);
-
-				// Maximum font size is equivalent to 180x180 pixels in area
-				while (w > 0) {
-					line = pgm_read_byte((uint8_t *)flash_address++); // 8 bytes smaller when incrementing here
-					if (line & 0x80) {
-						line &= 0x7F;
-						line++; w -= line;
-						pushBlock(textcolor,line);
-					}
-					else {
-						line++; w -= line;
-						pushBlock(textbgcolor,line);
-					}
-				}
-			}
-			else
-			{
-				int32_t px = 0, py = 0;  // To hold character pixel coords
-				int32_t tx = 0, ty = 0;  // To hold character TFT pixel coords
-				int32_t pc = 0;          // Pixel count
-				int32_t pl = 0;          // Pixel line length
-				uint16_t pcol = 0;       // Pixel color
-				bool     pf = true;      // Flag for plotting
-				while (pc < w) {
-					line = pgm_read_byte((uint8_t *)flash_address);
-					flash_address++;
-					if (line & 0x80) { pcol = textcolor; line &= 0x7F; pf = true;}
-					else { pcol = textbgcolor; if (textcolor == textbgcolor) pf = false;}
-					line++;
-					px = pc % width;
-					tx = x + textsize * px;
-					py = pc / width;
-					ty = y + textsize * py;
-
-					pl = 0;
-					pc += line;
-					while (line--) {
-						pl++;
-						if ((px+pl) >= width) {
-							if (pf) fillRect(tx, ty, pl * textsize, textsize, pcol);
-							pl = 0;
-							px = 0;
-							tx = x;
-							py ++;
-							ty += textsize;
-						}
-					}
-					if (pl && pf) fillRect(tx, ty, pl * textsize, textsize, pcol);
-				}
-			}
-		}
-		inTransaction = lockTransaction;
-		end_tft_write();
-	}
-	// End of RLE font rendering
-#endif
-
-#if !defined (LOAD_FONT2) && !defined (LOAD_RLE)
-	// Stop warnings
-	flash_address = flash_address;
-	w = w;
-	pX = pX;
-	pY = pY;
-	line = line;
-	clip = clip;
-#endif
-
-	return width * textsize;    // x +
+	return drawCachedChar(uniCode, x, y, font);
 }
 
 int16_t TFT_eSPI::drawChar(uint16_t uniCode, int32_t x, int32_t y)
@@ -587,18 +697,49 @@ int16_t TFT_eSPI::width(void)
 
 uint16_t TFT_eSPI::readPixel(int32_t x, int32_t y)
 {
-	assert(false && "readPixel not implemented yet");
-	return 0;
+	if (_vpOoB || !_fb) return 0;
+
+	x+= _xDatum;
+	y+= _yDatum;
+
+	// Range checking
+	if ((x < _vpX) || (y < _vpY) || (x >= _vpW) || (y >= _vpH)) return 0;
+
+	BUS_PRIMITIVE("readPixel");
+	busWindow();
+	busRead(1);
+
+	// The bus is busy until the DMA transfer is over
+	dmaWait();
+
+	return _fb[y * _width + x];
 }
 
+// Like the TFT controller the window is in screen coordinates and not clipped,
+// pixels written outside the screen are dropped
 void TFT_eSPI::setWindow(int32_t xs, int32_t ys, int32_t xe, int32_t ye)
 {
-	assert(false && "setWindow not implemented yet");
+	BUS_PRIMITIVE("setWindow");
+
+	if (xs > xe) std::swap(xs, xe);
+	if (ys > ye) std::swap(ys, ye);
+
+	win_xs = xs;
+	win_ys = ys;
+	win_xe = xe;
+	win_ye = ye;
+
+	win_x = xs;
+	win_y = ys;
+
+	busWindow();
 }
 
 void TFT_eSPI::pushColor(uint16_t color)
 {
+	BUS_PRIMITIVE("pushColor");
 
+	writeWindow(nullptr, color, 1, false);
 }
 
 void TFT_eSPI::begin_nin_write()
@@ -611,9 +752,34 @@ void TFT_eSPI::end_nin_write()
 
 }
 
-void TFT_eSPI::setRotation(uint8_t r)
+// The frame buffer is kept in the orientation of the rotation, so drawing is the same in all
+// rotations and the presenter turns the frame to the panel when it is uploaded
+void TFT_eSPI::setRotation(uint8_t m)
 {
-	rotation = r;
+	m &= 3;
+
+	int32_t w = m & 1 ? _init_height : _init_width;
+	int32_t h = m & 1 ? _init_width  : _init_height;
+
+	// Like the panel memory the pixels drawn so far stay where they are on the panel
+	if (_fb && m != rotation) {
+		dmaWait();
+		uint16_t *fb = new uint16_t[w * h];
+		rotateBlock(_fb, _width, _width, _height, fb, w, (rotation - m) & 3, 0);
+		delete [] _fb;
+		_fb = fb;
+		// Damage so far is in the old orientation
+		_damageCount = 0;
+		addDamage(0, 0, w, h);
+	}
+
+	rotation = m;
+	_width  = w;
+	_height = h;
+
+	addr_row = 0xFFFF;
+	addr_col = 0xFFFF;
+
 	// Reset the viewport to the whole screen
 	resetViewport();
 }
@@ -623,14 +789,20 @@ uint8_t TFT_eSPI::getRotation()
 	return rotation;
 }
 
+// Applied when the frame buffer is uploaded, the whole screen is shown again
 void TFT_eSPI::invertDisplay(bool i)
 {
-	assert(false && "invertDisplay not implemented yet");
+	if (i == _invert) return;
+
+	_invert = i;
+	if (_fb) addDamage(0, 0, _width, _height);
 }
 
 void TFT_eSPI::setAddrWindow(int32_t xs, int32_t ys, int32_t w, int32_t h)
 {
-	assert(false && "setAddrWindow not implemented yet");
+	begin_tft_write();
+	setWindow(xs, ys, xs + w - 1, ys + h - 1);
+	end_tft_write();
 }
 
 void TFT_eSPI::setViewport(int32_t x, int32_t y, int32_t w, int32_t h, bool vpDatum)
@@ -845,165 +1017,420 @@ bool TFT_eSPI::clipWindow(int32_t *xs, int32_t *ys, int32_t *xe, int32_t *ye)
 
 void TFT_eSPI::pushColor(uint16_t color, uint32_t len)  // Deprecated, use pushBlock()
 {
-	assert(false && "pushColor not implemented yet");
+	BUS_PRIMITIVE("pushColor");
+
+	pushBlock(color, len);
 }
 
 void TFT_eSPI::pushColors(uint16_t  *data, uint32_t len, bool swap) // With byte swap option
 {
-	assert(false && "pushColors not implemented yet");
+	BUS_PRIMITIVE("pushColors");
+
+	writeWindow(data, 0, len, !swap);
 }
 
 void TFT_eSPI::pushColors(uint8_t  *data, uint32_t len) // Deprecated, use pushPixels()
 {
-	assert(false && "pushColors not implemented yet");
+	BUS_PRIMITIVE("pushColors");
+
+	pushPixels(data, len >> 1);
 }
 
 // Write a solid block of a single colour
 void TFT_eSPI::pushBlock(uint16_t color, uint32_t len)
 {
-	assert(false && "pushBlock not implemented yet");
+	BUS_PRIMITIVE("pushBlock");
+
+	writeWindow(nullptr, color, len, false);
 }
 
 // Write a set of pixels stored in memory, use setSwapBytes(true/false) function to correct endianess
 void TFT_eSPI::pushPixels(const void * data_in, uint32_t len)
 {
-	assert(false && "pushPixels not implemented yet");
+	BUS_PRIMITIVE("pushPixels");
+
+	writeWindow((const uint16_t *)data_in, 0, len, !_swapBytes);
+}
+
+// The TFT receives the high colour byte first, so unless _swapBytes is set the
+// pixels in memory are in that byte order and are swapped to the frame buffer format
+void TFT_eSPI::writeWindow(const uint16_t *data, uint16_t color, uint32_t len, bool swap)
+{
+	if (!_fb || !len) return;
+
+	busPixels(len);
+
+	// The pixels follow those of a DMA transfer in progress on the bus
+	dmaWait();
+
+	// Only the last full pass over the window is visible for a solid block
+	uint64_t area = (uint64_t)(win_xe - win_xs + 1) * (win_ye - win_ys + 1);
+	if (!data && len > area) len = (uint32_t)(area + (len - area) % area);
+
+	fb_rect_t win = { win_xs, win_ys, win_xe + 1, win_ye + 1 };
+	int32_t x = win_x, y = win_y;
+	fb_rect_t rows = advanceWindow(len);
+
+	writeRows(_fb, _width, _height, win, x, y, data, color, len, swap);
+
+	if (rows.x0 < rows.x1) addDamage(rows.x0, rows.y0, rows.x1 - rows.x0, rows.y1 - rows.y0);
+
+	autoPresent();
+}
+
+// Advance the address window cursor by len pixels, wrapping like the TFT, and return the
+// area of the rows written clipped to the screen (empty if x0 >= x1)
+fb_rect_t TFT_eSPI::advanceWindow(uint32_t len)
+{
+	int32_t  winW = win_xe - win_xs + 1;
+	uint64_t area = (uint64_t)winW * (win_ye - win_ys + 1);
+
+	// Rows touched, the whole window once the cursor wraps to the top
+	uint64_t start = (uint64_t)(win_y - win_ys) * winW + (win_x - win_xs);
+	uint64_t end = start + len;
+	int32_t top = end > area ? win_ys : win_y;
+	int32_t bottom = end > area ? win_ye : win_ys + (int32_t)((end - 1) / winW);
+
+	end %= area;
+	win_x = win_xs + (int32_t)(end % winW);
+	win_y = win_ys + (int32_t)(end / winW);
+
+	fb_rect_t rows = { std::max(win_xs, 0), std::max(top, 0), std::min(win_xe + 1, _width), std::min(bottom + 1, _height) };
+	if (rows.y0 >= rows.y1) rows.x1 = rows.x0;
+	return rows;
+}
+
+// Write len pixels to the frame buffer from the cursor x, y of an address window, only
+// the parts of the rows on screen are stored. Also called by the DMA worker thread.
+void TFT_eSPI::writeRows(uint16_t *fb, int32_t width, int32_t height, fb_rect_t win, int32_t x, int32_t y,
+								 const uint16_t *data, uint16_t color, uint32_t len, bool swap)
+{
+	while (len) {
+		uint32_t n = std::min<uint32_t>(len, win.x1 - x);
+
+		if (y >= 0 && y < height) {
+			int32_t xs = std::max(x, 0);
+			int32_t xe = std::min<int32_t>(x + n, width);
+			if (xs < xe) {
+				uint16_t *dst = fb + y * width + xs;
+				if (!data)
+					std::fill_n(dst, xe - xs, color);
+				else if (!swap)
+					memcpy(dst, data + (xs - x), (xe - xs) * sizeof(uint16_t));
+				else
+					swap565(data + (xs - x), dst, xe - xs);
+			}
+		}
+
+		if (data) data += n;
+		len -= n;
+		x += n;
+		if (x >= win.x1) {
+			x = win.x0;
+			if (++y >= win.y1) y = win.y0;
+		}
+	}
 }
 
 void TFT_eSPI::fillScreen(uint32_t color)
 {
+	BUS_PRIMITIVE("fillScreen");
+
 	fillRect(0, 0, _width, _height, color);
 }
 
 void TFT_eSPI::drawRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color)
 {
-	assert(false && "drawRect not implemented yet");
+	if ((w < 1) || (h < 1)) return;
+
+	BUS_PRIMITIVE("drawRect");
+
+	// A rounded rectangle with radius 0
+	drawConic(x, y, x + w - 1, y + h - 1, 0, 0, 15, true, false, color);
+	autoPresent();
 }
 
 void TFT_eSPI::drawRoundRect(int32_t x, int32_t y, int32_t w, int32_t h, int32_t radius, uint32_t color)
 {
-	assert(false && "drawRoundRect not implemented yet");
+	if ((w < 1) || (h < 1)) return;
+
+	BUS_PRIMITIVE("drawRoundRect");
+
+	// The corner circles fit in the rectangle
+	radius = std::max(0, std::min(radius, (std::min(w, h) - 1) / 2));
+
+	drawConic(x + radius, y + radius, x + w - radius - 1, y + h - radius - 1, radius, radius, 15, true, false, color);
+	autoPresent();
 }
 
 void TFT_eSPI::fillRoundRect(int32_t x, int32_t y, int32_t w, int32_t h, int32_t radius, uint32_t color)
 {
-	assert(false && "fillRoundRect not implemented yet");
-}
+	if ((w < 1) || (h < 1)) return;
 
-void TFT_eSPI::fillRectVGradient(int16_t x, int16_t y, int16_t w, int16_t h, uint32_t color1, uint32_t color2)
-{
-	assert(false && "fillRectVGradient not implemented yet");
+	BUS_PRIMITIVE("fillRoundRect");
+
+	// The corner circles fit in the rectangle
+	radius = std::max(0, std::min(radius, (std::min(w, h) - 1) / 2));
+
+	drawConic(x + radius, y + radius, x + w - radius - 1, y + h - radius - 1, radius, radius, 15, true, true, color);
+	autoPresent();
 }
 
-void TFT_eSPI::fillRectHGradient(int16_t x, int16_t y, int16_t w, int16_t h, uint32_t color1, uint32_t color2)
+// Spans of the conic quarters around the corners of a box, see TFT_eSPI.h. Each row of a quarter
+// reaches to the last pixel inside the ellipse with radii rx + 0.5 and ry + 0.5, found by walking
+// x inwards as the rows move away from the centre. An outline row covers the pixels from its own
+// end to just past the end of the next row out, so outlines are 8-connected and the edge of the fill.
+void TFT_eSPI::drawConic(int32_t cx0, int32_t cy0, int32_t cx1, int32_t cy1, int32_t rx, int32_t ry,
+								 uint8_t quarters, bool middle, bool fill, uint32_t color)
 {
-	assert(false && "fillRectHGradient not implemented yet");
+	if (_vpOoB || (rx < 0) || (ry < 0) || (cx1 < cx0) || (cy1 < cy0)) return;
+
+	// Half width of the row at distance d from the box, the largest x <= rx (or 0) with
+	// 4 * (x^2 * b + d^2 * a) <= a * b. Only the rows that are drawn are computed: the first
+	// from a square root estimate, the next ones walk from the width of the row before.
+	// The widths are exact while the products fit in 64 bits.
+	int64_t a = (int64_t)(2 * (int64_t)rx + 1) * (2 * (int64_t)rx + 1), b = (int64_t)(2 * (int64_t)ry + 1) * (2 * (int64_t)ry + 1);
+	bool exact = std::max(rx, ry) < (1 << 14);
+	int32_t lastD[2] = { -2, -2 }, lastX[2] = { 0, 0 }; // The two rows computed last, [0] most recent
+	auto half = [&](int32_t d) -> int32_t {
+		if (d > ry) return -1;
+		if (d == lastD[0]) return lastX[0];
+		if (d == lastD[1]) return lastX[1];
+
+		int32_t x;
+		if (exact && (std::abs(d - lastD[0]) <= 2)) x = lastX[0];
+		else {
+			double t = 2.0 * d / (2.0 * ry + 1);
+			x = std::min((int32_t)((rx + 0.5) * sqrt(std::max(0.0, 1.0 - t * t))), rx);
+		}
+		if (exact) {
+			auto inside = [&](int64_t xi) { return 4 * (xi * xi * b + (int64_t)d * d * a) <= a * b; };
+			while (x < rx && inside(x + 1)) x++;
+			while (x > 0 && !inside(x)) x--;
+		}
+		lastD[1] = lastD[0]; lastX[1] = lastX[0];
+		lastD[0] = d;        lastX[0] = x;
+		return x;
+	};
+
+	// Rows outside the viewport are skipped, drawSpans() clips the rest
+	int32_t vy0 = _vpY - _yDatum, vy1 = _vpH - _yDatum;
+
+	fb_span_t spans[64];
+	uint32_t n = 0;
+	auto add = [&](int32_t xs, int32_t xe, int32_t y) {
+		spans[n++] = { xs, xe, y };
+		if (n == 64) { drawSpans(spans, n, color); n = 0; }
+	};
+
+	// Row y at distance d from the box, between rows continue the sides of the box
+	auto row = [&](int32_t y, int32_t d, bool left, bool right, bool between) {
+		if (y < vy0 || y >= vy1 || !(left || right)) return;
+
+		int32_t h = half(d);
+		if (fill) {
+			add(left ? cx0 - h : cx0, right ? cx1 + h : cx1, y);
+			return;
+		}
+
+		int32_t start = between ? h : std::min(half(d + 1) + 1, h);
+		if (left && right && ((d == ry && !between) || (cx0 - start + 1 >= cx1 + start)))
+			add(cx0 - h, cx1 + h, y);
+		else {
+			if (left)  add(cx0 - h, cx0 - start, y);
+			if (right) add(cx1 + start, cx1 + h, y);
+		}
+	};
+
+	// Above the box row cy0 - d, below it row cy1 + d, for the distances d with visible rows
+	int32_t d1 = (int32_t)std::min<int64_t>(ry, (int64_t)cy0 - vy0);
+	int32_t d0 = (int32_t)std::max<int64_t>(1, (int64_t)cy0 - vy1 + 1);
+	for (int32_t d = d1; d >= d0; d--) row(cy0 - d, d, quarters & 1, quarters & 2, false);
+	if (middle) {
+		for (int32_t y = std::max(cy0, vy0); y <= std::min(cy1, vy1 - 1); y++)
+			row(y, 0, quarters & 9, quarters & 6, y != cy0 && y != cy1);
+	}
+	d0 = (int32_t)std::max<int64_t>(1, (int64_t)vy0 - cy1);
+	d1 = (int32_t)std::min<int64_t>(ry, (int64_t)vy1 - 1 - cy1);
+	for (int32_t d = d0; d <= d1; d++) row(cy1 + d, d, quarters & 8, quarters & 4, false);
+
+	if (n) drawSpans(spans, n, color);
 }
 
-uint16_t TFT_eSPI::drawPixel(int32_t x, int32_t y, uint32_t color, uint8_t alpha, uint32_t bg_color)
+void TFT_eSPI::drawCircle(int32_t x, int32_t y, int32_t r, uint32_t color)
 {
-	return 0;
+	BUS_PRIMITIVE("drawCircle");
+
+	drawConic(x, y, x, y, r, r, 15, true, false, color);
+	autoPresent();
 }
 
-void TFT_eSPI::drawSpot(float ax, float ay, float r, uint32_t fg_color, uint32_t bg_color)
+// Quarter circles, cornername bits 1 top left, 2 top right, 4 bottom right, 8 bottom left
+void TFT_eSPI::drawCircleHelper(int32_t x, int32_t y, int32_t r, uint8_t cornername, uint32_t color)
 {
-	assert(false && "drawSpot not implemented yet");
+	BUS_PRIMITIVE("drawCircleHelper");
+
+	drawConic(x, y, x, y, r, r, cornername & 15, true, false, color);
+	autoPresent();
 }
 
-void TFT_eSPI::fillSmoothCircle(int32_t x, int32_t y, int32_t r, uint32_t color, uint32_t bg_color)
+void TFT_eSPI::fillCircle(int32_t x, int32_t y, int32_t r, uint32_t color)
 {
-	assert(false && "fillSmoothCircle not implemented yet");
+	BUS_PRIMITIVE("fillCircle");
+
+	drawConic(x, y, x, y, r, r, 15, true, true, color);
+	autoPresent();
 }
 
-void TFT_eSPI::fillSmoothRoundRect(int32_t x, int32_t y, int32_t w, int32_t h, int32_t radius, uint32_t color, uint32_t bg_color)
+// Half circles without the centre row stretched delta pixels to the right, cornername bit 1 fills the
+// bottom half and bit 2 the top half
+void TFT_eSPI::fillCircleHelper(int32_t x, int32_t y, int32_t r, uint8_t cornername, int32_t delta, uint32_t color)
 {
-	assert(false && "fillSmoothRoundRect not implemented yet");
+	BUS_PRIMITIVE("fillCircleHelper");
+
+	drawConic(x, y, x + delta, y, r, r, (cornername & 1 ? 12 : 0) | (cornername & 2 ? 3 : 0), false, true, color);
+	autoPresent();
 }
 
-void TFT_eSPI::drawWideLine(float ax, float ay, float bx, float by, float wd, uint32_t fg_color, uint32_t bg_color)
+void TFT_eSPI::drawEllipse(int16_t x, int16_t y, int32_t rx, int32_t ry, uint16_t color)
 {
-	assert(false && "drawWideLine not implemented yet");
+	BUS_PRIMITIVE("drawEllipse");
+
+	drawConic(x, y, x, y, rx, ry, 15, true, false, color);
+	autoPresent();
 }
 
-void TFT_eSPI::drawWedgeLine(float ax, float ay, float bx, float by, float aw, float bw, uint32_t fg_color, uint32_t bg_color)
+void TFT_eSPI::fillEllipse(int16_t x, int16_t y, int32_t rx, int32_t ry, uint16_t color)
 {
-	assert(false && "drawWedgeLine not implemented yet");
+	BUS_PRIMITIVE("fillEllipse");
+
+	drawConic(x, y, x, y, rx, ry, 15, true, true, color);
+	autoPresent();
 }
 
-void TFT_eSPI::drawCircle(int32_t x, int32_t y, int32_t r, uint32_t color)
+void TFT_eSPI::drawTriangle(int32_t x1,int32_t y1, int32_t x2,int32_t y2, int32_t x3,int32_t y3, uint32_t color)
 {
-	assert(false && "drawCircle not implemented yet");
+	BUS_PRIMITIVE("drawTriangle");
+
+	drawLine(x1, y1, x2, y2, color);
+	drawLine(x2, y2, x3, y3, color);
+	drawLine(x3, y3, x1, y1, color);
 }
 
-void TFT_eSPI::drawCircleHelper(int32_t x, int32_t y, int32_t r, uint8_t cornername, uint32_t color)
+void TFT_eSPI::fillTriangle(int32_t x1,int32_t y1, int32_t x2,int32_t y2, int32_t x3,int32_t y3, uint32_t color)
 {
-	assert(false && "drawCircleHelper not implemented yet");
+	BUS_PRIMITIVE("fillTriangle");
+
+	tft_triangle_t t = { x1, y1, x2, y2, x3, y3, color };
+	fillTriangles(&t, 1);
 }
 
-void TFT_eSPI::fillCircle(int32_t x0, int32_t y0, int32_t r, uint32_t color)
+void TFT_eSPI::fillTriangles(const tft_triangle_t *triangles, uint32_t count)
 {
-	int32_t  x  = 0;
-	int32_t  dx = 1;
-	int32_t  dy = r+r;
-	int32_t  p  = -(r>>1);
+	BUS_PRIMITIVE("fillTriangles");
 
-	drawFastHLine(x0 - r, y0, dy+1, color);
-
-	while(x<r){
+	if (_vpOoB) return;
 
-		if(p>=0) {
-			drawFastHLine(x0 - x, y0 + r, dx, color);
-			drawFastHLine(x0 - x, y0 - r, dx, color);
-			dy-=2;
-			p-=dy;
-			r--;
+	// Spans of triangles with the same colour are drawn together
+	fb_span_t spans[64];
+	uint32_t n = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		if (n && triangles[i].color != triangles[i - 1].color) {
+			drawSpans(spans, n, triangles[i - 1].color);
+			n = 0;
 		}
-
-		dx+=2;
-		p+=dx;
-		x++;
-
-		drawFastHLine(x0 - r, y0 + x, dy+1, color);
-		drawFastHLine(x0 - r, y0 - x, dy+1, color);
-
+		triangleSpans(triangles[i], spans, n);
 	}
+	if (n) drawSpans(spans, n, triangles[count - 1].color);
 
-	SDL_RenderPresent(SDL_RENDERER);
+	autoPresent();
 }
 
-void TFT_eSPI::fillCircleHelper(int32_t x, int32_t y, int32_t r, uint8_t cornername, int32_t delta, uint32_t color)
+static int64_t floorDiv(int64_t a, int64_t b)
 {
-	assert(false && "fillCircleHelper not implemented yet");
+	int64_t q = a / b;
+	return (a % b != 0 && ((a < 0) != (b < 0))) ? q - 1 : q;
 }
 
-void TFT_eSPI::drawEllipse(int16_t x, int16_t y, int32_t rx, int32_t ry, uint16_t color)
-{
-	assert(false && "drawEllipse not implemented yet");
-}
+// Edge from xa,ya to xb,yb (ya < yb) walked down the rows. x is the edge crossing of the row
+// rounded to the nearest pixel, kept as x + r / den with 0 <= r < den, so that each row
+// steps x and r without a division.
+struct tri_edge_t {
+	int32_t x, r, den, stepX, stepR;
 
-void TFT_eSPI::fillEllipse(int16_t x, int16_t y, int32_t rx, int32_t ry, uint16_t color)
-{
-	assert(false && "fillEllipse not implemented yet");
-}
+	void init(int32_t xa, int32_t ya, int32_t xb, int32_t yb, int32_t y) {
+		int32_t dy = yb - ya;
+		den = 2 * dy;
+		int64_t v = 2 * ((int64_t)xa * dy + (int64_t)(xb - xa) * (y - ya)) + dy;
+		x = (int32_t)floorDiv(v, den);
+		r = (int32_t)(v - (int64_t)x * den);
+		int64_t s = 2 * (int64_t)(xb - xa);
+		stepX = (int32_t)floorDiv(s, den);
+		stepR = (int32_t)(s - (int64_t)stepX * den);
+	}
 
-void TFT_eSPI::drawTriangle(int32_t x1,int32_t y1, int32_t x2,int32_t y2, int32_t x3,int32_t y3, uint32_t color)
-{
-	assert(false && "drawTriangle not implemented yet");
-}
+	void step() {
+		x += stepX;
+		r += stepR;
+		if (r >= den) { r -= den; x++; }
+	}
+};
 
-void TFT_eSPI::fillTriangle(int32_t x1,int32_t y1, int32_t x2,int32_t y2, int32_t x3,int32_t y3, uint32_t color)
+// Each row is filled from the long edge (top to bottom corner) to the edge of the other corner.
+// The triangle is clipped to the viewport rows first, drawSpans() clips the columns.
+void TFT_eSPI::triangleSpans(const tft_triangle_t &t, fb_span_t *spans, uint32_t &count)
 {
-	assert(false && "fillTriangle not implemented yet");
+	int32_t x0 = t.x1, y0 = t.y1, x1 = t.x2, y1 = t.y2, x2 = t.x3, y2 = t.y3;
+
+	// Sort the corners by y (y2 >= y1 >= y0)
+	if (y0 > y1) { swap_coord(y0, y1); swap_coord(x0, x1); }
+	if (y1 > y2) { swap_coord(y2, y1); swap_coord(x2, x1); }
+	if (y0 > y1) { swap_coord(y0, y1); swap_coord(x0, x1); }
+
+	int32_t vy0 = _vpY - _yDatum, vy1 = _vpH - _yDatum - 1;
+	int32_t vx0 = _vpX - _xDatum, vx1 = _vpW - _xDatum - 1;
+	if ((y2 < vy0) || (y0 > vy1)) return;
+	if ((std::max({ x0, x1, x2 }) < vx0) || (std::min({ x0, x1, x2 }) > vx1)) return;
+
+	auto add = [&](int32_t a, int32_t b, int32_t y) {
+		spans[count++] = { std::min(a, b), std::max(a, b), y };
+		if (count == 64) { drawSpans(spans, count, t.color); count = 0; }
+	};
+
+	// All corners on one row
+	if (y0 == y2) {
+		add(std::min({ x0, x1, x2 }), std::max({ x0, x1, x2 }), y0);
+		return;
+	}
+
+	int32_t ys = std::max(y0, vy0), ye = std::min(y2, vy1);
+
+	tri_edge_t lng, shrt = {};
+	lng.init(x0, y0, x2, y2, ys);
+	if (ys < y1) shrt.init(x0, y0, x1, y1, ys);
+	else if (ys > y1) shrt.init(x1, y1, x2, y2, ys);
+
+	for (int32_t y = ys; y <= ye; y++) {
+		if (y == y1) {
+			add(lng.x, x1, y);
+			if (y1 < y2) shrt.init(x1, y1, x2, y2, y + 1);
+		}
+		else {
+			add(lng.x, shrt.x, y);
+			shrt.step();
+		}
+		lng.step();
+	}
 }
 
 void TFT_eSPI::setSwapBytes(bool swap)
 {
-
+	_swapBytes = swap;
 }
 
 bool TFT_eSPI::getSwapBytes()
 {
-	return 0;
+	return _swapBytes;
 }
 
 void TFT_eSPI::drawBitmap( int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int16_t h, uint16_t fgcolor)
@@ -1033,84 +1460,257 @@ void TFT_eSPI::setBitmapColor(uint16_t fgcolor, uint16_t bgcolor)
 
 void TFT_eSPI::setPivot(int16_t x, int16_t y)
 {
-	assert(false && "setPivot not implemented yet");
+	_xPivot = x;
+	_yPivot = y;
 }
 
 int16_t TFT_eSPI::getPivotX(void)
 {
-	assert(false && "getPivotX not implemented yet");
-	return 0;
+	return _xPivot;
 }
 
 int16_t TFT_eSPI::getPivotY(void)
 {
-	assert(false && "getPivotY not implemented yet");
-	return 0;
+	return _yPivot;
 }
 
+// The block is stored like pushRect() expects it: rows of w pixels in TFT byte order,
+// pixels outside the viewport are left unchanged
 void TFT_eSPI::readRect(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t *data)
 {
-	assert(false && "readRect not implemented yet");
+	if (!_fb) return;
+
+	BUS_PRIMITIVE("readRect");
+
+	PI_CLIP;
+
+	busWindow();
+	busRead(dw * dh);
+	dmaWait();
+
+	data += dx + dy * w;
+	const uint16_t *row = _fb + y * _width + x;
+	for (int32_t j = 0; j < dh; j++) {
+		swap565(row, data, dw);
+		data += w;
+		row += _width;
+	}
 }
 
 void TFT_eSPI::pushRect(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t *data)
 {
-	assert(false && "pushRect not implemented yet");
+	BUS_PRIMITIVE("pushRect");
+
+	bool swap = _swapBytes;
+	_swapBytes = false;
+	pushImage(x, y, w, h, data);
+	_swapBytes = swap;
 }
 
 void TFT_eSPI::pushImage(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t *data)
 {
-	assert(false && "pushImage not implemented yet");
+	pushImage(x, y, w, h, (const uint16_t *)data);
 }
 
 void TFT_eSPI::pushImage(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t *data, uint16_t transparent)
 {
-	assert(false && "pushImage not implemented yet");
+	pushImage(x, y, w, h, (const uint16_t *)data, transparent);
 }
 
 void TFT_eSPI::pushImage(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data, uint16_t transparent)
 {
-	assert(false && "pushImage not implemented yet");
+	BUS_PRIMITIVE("pushImage");
+
+	PI_CLIP;
+
+	dmaWait();
+
+	data += dx + dy * w;
+
+	uint16_t *row = _fb + y * _width + x;
+
+	// The transparent colour is compared in the byte order of the image
+	if (!_swapBytes) transparent = transparent >> 8 | transparent << 8;
+
+	// Each run of opaque pixels is sent to its own window
+	for (int32_t j = 0; j < dh; j++) {
+		bool run = false;
+		for (int32_t i = 0; i < dw; i++) {
+			uint16_t color = data[i];
+			if (color != transparent) {
+				row[i] = _swapBytes ? color : (color >> 8 | color << 8);
+				if (!run) busWindow();
+				busPixels(1);
+			}
+			run = color != transparent;
+		}
+		data += w;
+		row += _width;
+	}
+
+	addDamage(x, y, dw, dh);
+
+	autoPresent();
 }
 
 void TFT_eSPI::pushImage(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data)
 {
-	assert(false && "pushImage not implemented yet");
+	BUS_PRIMITIVE("pushImage");
+
+	PI_CLIP;
+
+	dmaWait();
+
+	data += dx + dy * w;
+
+	uint16_t *row = _fb + y * _width + x;
+
+	busWindow();
+	busPixels(dw * dh);
+
+	// Without _swapBytes the image is in TFT byte order (high byte first), see writeWindow()
+	for (int32_t j = 0; j < dh; j++) {
+		if (!_swapBytes)
+			swap565(data, row, dw);
+		else
+			memcpy(row, data, dw * sizeof(uint16_t));
+		data += w;
+		row += _width;
+	}
+
+	addDamage(x, y, dw, dh);
+
+	autoPresent();
 }
 
 void TFT_eSPI::pushImage(int32_t x, int32_t y, int32_t w, int32_t h, uint8_t *data, bool bpp8, uint16_t *cmap)
 {
-	assert(false && "pushImage not implemented yet");
+	pushImage(x, y, w, h, (const uint8_t *)data, bpp8, cmap);
 }
 
+// 8 bpp pixels are RGB332 colours, 4 bpp pixels (two per byte, high nibble first) are indices into
+// cmap and 1 bpp pixels (rows padded to bytes, MSB first) are drawn in the bitmap colours
 void TFT_eSPI::pushImage(int32_t x, int32_t y, int32_t w, int32_t h, uint8_t *data, uint8_t transparent, bool bpp8, uint16_t *cmap)
 {
-	assert(false && "pushImage not implemented yet");
+	BUS_PRIMITIVE("pushImage");
+
+	PI_CLIP;
+
+	dmaWait();
+
+	uint16_t *row = _fb + y * _width + x;
+
+	// The transparent value is compared with the pixel value, before any colour conversion
+	// Each run of opaque pixels is sent to its own window
+	for (int32_t j = 0; j < dh; j++) {
+		int32_t yp = dy + j;
+		bool run = false;
+		for (int32_t i = 0; i < dw; i++) {
+			int32_t xp = dx + i;
+			uint8_t value;
+			uint16_t color;
+			if (bpp8) {
+				value = data[xp + yp * w];
+				color = color8to16(value);
+			}
+			else if (cmap) {
+				value = (data[(xp >> 1) + yp * ((w + 1) >> 1)] >> (xp & 1 ? 0 : 4)) & 0x0F;
+				color = cmap[value];
+			}
+			else {
+				value = (data[(xp >> 3) + yp * ((w + 7) >> 3)] >> (7 - (xp & 7))) & 1;
+				color = value ? bitmap_fg : bitmap_bg;
+			}
+
+			if (value != transparent) {
+				row[i] = color;
+				if (!run) busWindow();
+				busPixels(1);
+			}
+			run = value != transparent;
+		}
+		row += _width;
+	}
+
+	addDamage(x, y, dw, dh);
+
+	autoPresent();
 }
 
 void TFT_eSPI::pushImage(int32_t x, int32_t y, int32_t w, int32_t h, const uint8_t *data, bool bpp8, uint16_t *cmap)
 {
-	assert(false && "pushImage not implemented yet");
+	BUS_PRIMITIVE("pushImage");
+
+	PI_CLIP;
+
+	dmaWait();
+
+	uint16_t *row = _fb + y * _width + x;
+
+	busWindow();
+	busPixels(dw * dh);
+
+	for (int32_t j = 0; j < dh; j++) {
+		int32_t yp = dy + j;
+		if (bpp8)
+			color332to565(data + dx + yp * w, row, dw);
+		else if (cmap) {
+			const uint8_t *line = data + yp * ((w + 1) >> 1);
+			for (int32_t i = 0; i < dw; i++) {
+				int32_t xp = dx + i;
+				row[i] = cmap[(line[xp >> 1] >> (xp & 1 ? 0 : 4)) & 0x0F];
+			}
+		}
+		else {
+			const uint8_t *line = data + yp * ((w + 7) >> 3);
+			for (int32_t i = 0; i < dw; i++) {
+				int32_t xp = dx + i;
+				row[i] = line[xp >> 3] & (0x80 >> (xp & 7)) ? bitmap_fg : bitmap_bg;
+			}
+		}
+		row += _width;
+	}
+
+	addDamage(x, y, dw, dh);
+
+	autoPresent();
 }
 
+// Rows of w pixels with 3 bytes each, pixels outside the viewport are left unchanged
 void TFT_eSPI::readRectRGB(int32_t x, int32_t y, int32_t w, int32_t h, uint8_t *data)
 {
-	assert(false && "readRectRGB not implemented yet");
+	if (!_fb) return;
+
+	BUS_PRIMITIVE("readRectRGB");
+
+	PI_CLIP;
+
+	busWindow();
+	busRead(dw * dh);
+	dmaWait();
+
+	data += 3 * (dx + dy * w);
+	const uint16_t *row = _fb + y * _width + x;
+	for (int32_t j = 0; j < dh; j++) {
+		color565to888(row, data, dw);
+		data += 3 * w;
+		row += _width;
+	}
 }
 
 int16_t TFT_eSPI::drawNumber(long long_num, int32_t poX, int32_t poY, uint8_t font)
 {
 	isDigits = true; // Eliminate jiggle in monospaced fonts
-	char str[12];
-	ltoa(long_num, str, 10);
-	return drawString(str, poX, poY, textfont);
+	char str[24];
+	snprintf(str, sizeof(str), "%ld", long_num);
+	return drawString(str, poX, poY, font);
 }
 
 int16_t TFT_eSPI::drawNumber(long long_num, int32_t poX, int32_t poY)
 {
 	isDigits = true; // Eliminate jiggle in monospaced fonts
-	char str[12];
-	ltoa(long_num, str, 10);
+	char str[24];
+	snprintf(str, sizeof(str), "%ld", long_num);
 	return drawString(str, poX, poY, textfont);
 }
 
@@ -1159,6 +1759,16 @@ int16_t TFT_eSPI::drawString(const char *string, int32_t poX, int32_t poY)
 
 // With font number. Note: font number is over-ridden if a smooth font is loaded
 int16_t TFT_eSPI::drawString(const char *string, int32_t poX, int32_t poY, uint8_t font)
+{
+	BUS_PRIMITIVE("drawString");
+
+	int16_t sumX = drawTextRun(string, poX, poY, font);
+	autoPresent();
+	return sumX;
+}
+
+// Renders the string glyph by glyph, the spans go to textSpans() and textRect()
+int16_t TFT_eSPI::renderString(const char *string, int32_t poX, int32_t poY, uint8_t font)
 {
 	int16_t sumX = 0;
 	uint8_t padding = 1, baseline = 0;
@@ -1269,7 +1879,7 @@ int16_t TFT_eSPI::drawString(const char *string, int32_t poX, int32_t poY, uint8
 
 		if((c2 >= pgm_read_word(&gfxFont->first)) && (c2 <= pgm_read_word(&gfxFont->last) )) {
 			c2 -= pgm_read_word(&gfxFont->first);
-			GFXglyph *glyph = &(((GFXglyph *)pgm_read_dword(&gfxFont->glyph))[c2]);
+			GFXglyph *glyph = &(((GFXglyph *)pgm_read_ptr(&gfxFont->glyph))[c2]);
 			xo = pgm_read_byte(&glyph->xOffset) * textsize;
 			// Adjust for negative xOffset
 			if (xo > 0) xo = 0;
@@ -1277,7 +1887,7 @@ int16_t TFT_eSPI::drawString(const char *string, int32_t poX, int32_t poY, uint8
 			// Add 1 pixel of padding all round
 			//cheight +=2;
 			//fillRect(poX+xo-1, poY - 1 - glyph_ab * textsize, cwidth+2, cheight, textbgcolor);
-			fillRect(poX+xo, poY - glyph_ab * textsize, cwidth, cheight, textbgcolor);
+			textRect(poX+xo, poY - glyph_ab * textsize, cwidth, cheight, textbgcolor);
 		}
 		padding -=100;
 	}
@@ -1325,20 +1935,21 @@ int16_t TFT_eSPI::drawString(const char *string, int32_t poX, int32_t poY, uint8
 			poX +=xo; // Adjust for negative offset start character
 			poY -= glyph_ab * textsize;
 			sumX += poX;
+			if (_textRecord) _textRecord->addsX = true; // The cached width depends on the position
 		}
 #endif
 		switch(padding) {
 		case 1:
-			fillRect(padXc,poY,padX-cwidth,cheight, textbgcolor);
+			textRect(padXc,poY,padX-cwidth,cheight, textbgcolor);
 			break;
 		case 2:
-			fillRect(padXc,poY,(padX-cwidth)>>1,cheight, textbgcolor);
+			textRect(padXc,poY,(padX-cwidth)>>1,cheight, textbgcolor);
 			padXc = poX - ((padX-cwidth)>>1);
-			fillRect(padXc,poY,(padX-cwidth)>>1,cheight, textbgcolor);
+			textRect(padXc,poY,(padX-cwidth)>>1,cheight, textbgcolor);
 			break;
 		case 3:
 			if (padXc>padX) padXc = padX;
-			fillRect(poX + cwidth - padXc,poY,padXc-cwidth,cheight, textbgcolor);
+			textRect(poX + cwidth - padXc,poY,padXc-cwidth,cheight, textbgcolor);
 			break;
 		}
 	}
@@ -1429,25 +2040,25 @@ int16_t TFT_eSPI::drawRightString(const char *string, int32_t dX, int32_t poY, u
 
 void TFT_eSPI::setCursor(int16_t x, int16_t y)
 {
-	assert(false && "setCursor not implemented yet");
-
+	cursor_x = x;
+	cursor_y = y;
 }
 
 void TFT_eSPI::setCursor(int16_t x, int16_t y, uint8_t font)
 {
-	assert(false && "setCursor not implemented yet");
+	setTextFont(font);
+	cursor_x = x;
+	cursor_y = y;
 }
 
 int16_t TFT_eSPI::getCursorX(void)
 {
-	assert(false && "getCursorX not implemented yet");
-	return 0;
+	return cursor_x;
 }
 
 int16_t TFT_eSPI::getCursorY(void)
 {
-	assert(false && "getCursorY not implemented yet");
-	return 0;
+	return cursor_y;
 }
 
 void TFT_eSPI::setTextColor(uint16_t c)
@@ -1472,39 +2083,66 @@ void TFT_eSPI::setTextSize(uint8_t s)
 
 void TFT_eSPI::setTextWrap(bool wrapX, bool wrapY)
 {
-	assert(false && "setTextWrap not implemented yet");
+	textwrapX = wrapX;
+	textwrapY = wrapY;
 }
 
 void TFT_eSPI::setTextDatum(uint8_t datum)
 {
-	assert(false && "setTextDatum not implemented yet");
+	textdatum = datum;
 }
 
 uint8_t TFT_eSPI::getTextDatum()
 {
-	assert(false && "getTextDatum not implemented yet");
-	return 0;
+	return textdatum;
 }
 
 void TFT_eSPI::setTextPadding(uint16_t x_width)
 {
-	assert(false && "setTextPadding not implemented yet");
+	padX = x_width;
 }
 
 uint16_t TFT_eSPI::getTextPadding()
 {
-	assert(false && "getTextPadding not implemented yet");
-	return 0;
+	return padX;
 }
 
+#ifdef LOAD_GFXFF
+void TFT_eSPI::setFreeFont(const GFXfont *f)
+{
+	if (f == nullptr) { // Use the GLCD font
+		setTextFont(1);
+		return;
+	}
+
+	textfont = 1;
+	gfxFont = (GFXfont *)f;
+
+	// Find the biggest above and below baseline offsets
+	glyph_ab = 0;
+	glyph_bb = 0;
+	uint16_t numChars = pgm_read_word(&gfxFont->last) - pgm_read_word(&gfxFont->first) + 1;
+	const GFXglyph *glyphs = (const GFXglyph *)pgm_read_ptr(&gfxFont->glyph);
+	for (uint16_t c = 0; c < numChars; c++) {
+		int8_t ab = -(int8_t)pgm_read_byte(&glyphs[c].yOffset);
+		if (ab > glyph_ab) glyph_ab = ab;
+		int8_t bb = pgm_read_byte(&glyphs[c].height) - ab;
+		if (bb > glyph_bb) glyph_bb = bb;
+	}
+}
+#else
 void TFT_eSPI::setFreeFont(uint8_t font)
 {
-	assert(false && "setFreeFont not implemented yet");
+	setTextFont(font);
 }
+#endif
 
 void TFT_eSPI::setTextFont(uint8_t font)
 {
-	assert(false && "setTextFont not implemented yet");
+	textfont = (font > 0) ? font : 1; // Don't allow font 0
+#ifdef LOAD_GFXFF
+	gfxFont = nullptr;
+#endif
 }
 
 int16_t TFT_eSPI::textWidth(const char *string, uint8_t font)
@@ -1536,7 +2174,7 @@ int16_t TFT_eSPI::textWidth(const char *string, uint8_t font)
 #endif
 
 	if (font>1 && font<9) {
-		char *widthtable = (char *)pgm_read_dword( &(fontdata[font].widthtbl ) ) - 32; //subtract the 32 outside the loop
+		char *widthtable = (char *)pgm_read_ptr( &(fontdata[font].widthtbl ) ) - 32; //subtract the 32 outside the loop
 
 		while (*string) {
 			uniCode = *(string++);
@@ -1554,7 +2192,7 @@ int16_t TFT_eSPI::textWidth(const char *string, uint8_t font)
 				uniCode = decodeUTF8(*string++);
 				if ((uniCode >= pgm_read_word(&gfxFont->first)) && (uniCode <= pgm_read_word(&gfxFont->last ))) {
 					uniCode -= pgm_read_word(&gfxFont->first);
-					GFXglyph *glyph  = &(((GFXglyph *)pgm_read_dword(&gfxFont->glyph))[uniCode]);
+					GFXglyph *glyph  = &(((GFXglyph *)pgm_read_ptr(&gfxFont->glyph))[uniCode]);
 					// If this is not the  last character or is a digit then use xAdvance
 					if (*string  || isDigits) str_width += pgm_read_byte(&glyph->xAdvance);
 					// Else use the offset plus width since this can be bigger than xAdvance
@@ -1601,14 +2239,22 @@ int16_t TFT_eSPI::textWidth(const String& string)
 
 int16_t TFT_eSPI::fontHeight(int16_t font)
 {
-	assert(false && "fontHeight not implemented yet");
-	return 0;
+	if (font > 8) return 0;
+
+#ifdef SMOOTH_FONT
+	if (fontLoaded) return gFont.yAdvance;
+#endif
+
+#ifdef LOAD_GFXFF
+	if (font == 1 && gfxFont) return pgm_read_byte(&gfxFont->yAdvance) * textsize;
+#endif
+
+	return pgm_read_byte( &fontdata[font].height ) * textsize;
 }
 
 int16_t TFT_eSPI::fontHeight()
 {
-	assert(false && "fontHeight not implemented yet");
-	return 0;
+	return fontHeight(textfont);
 }
 
 uint16_t TFT_eSPI::decodeUTF8(uint8_t *buf, uint16_t *index, uint16_t remaining)
@@ -1681,9 +2327,91 @@ uint16_t TFT_eSPI::decodeUTF8(uint8_t c)
 	return c; // fall-back to extended ASCII
 }
 
-size_t TFT_eSPI::write(uint8_t)
+size_t TFT_eSPI::write(uint8_t utf8)
 {
-	return 0;
+	if (_vpOoB) return 1;
+
+	uint16_t uniCode = decodeUTF8(utf8);
+
+	if (!uniCode) return 1;
+
+	if (utf8 == '\r') return 1;
+
+#ifdef SMOOTH_FONT
+	// drawGlyph() moves the cursor down gFont.yAdvance for a new line
+	if (fontLoaded) {
+		if ((uniCode < 32) && (utf8 != '\n')) return 1;
+		drawGlyph(uniCode);
+		return 1;
+	}
+#endif
+
+#ifdef LOAD_GFXFF
+	if (gfxFont) {
+		if (utf8 == '\n') {
+			cursor_x  = 0;
+			cursor_y += (int16_t)textsize * (uint8_t)pgm_read_byte(&gfxFont->yAdvance);
+			return 1;
+		}
+
+		if ((uniCode < pgm_read_word(&gfxFont->first)) || (uniCode > pgm_read_word(&gfxFont->last))) return 1;
+
+		uint16_t  c2    = uniCode - pgm_read_word(&gfxFont->first);
+		GFXglyph *glyph = &(((GFXglyph *)pgm_read_ptr(&gfxFont->glyph))[c2]);
+		uint8_t   w     = pgm_read_byte(&glyph->width),
+					 h     = pgm_read_byte(&glyph->height);
+		if ((w > 0) && (h > 0)) { // Is there an associated bitmap?
+			int16_t xo = (int8_t)pgm_read_byte(&glyph->xOffset);
+			if (textwrapX && ((cursor_x + textsize * (xo + w)) > width())) {
+				// Drawing character would go off right edge; wrap to new line
+				cursor_x  = 0;
+				cursor_y += (int16_t)textsize * (uint8_t)pgm_read_byte(&gfxFont->yAdvance);
+			}
+			if (textwrapY && (cursor_y >= (int32_t) height())) cursor_y = 0;
+			drawChar(cursor_x, cursor_y, uniCode, textcolor, textbgcolor, textsize);
+		}
+		cursor_x += pgm_read_byte(&glyph->xAdvance) * (int16_t)textsize;
+		return 1;
+	}
+#endif
+
+	if (uniCode == '\n') uniCode += 22; // Make it a valid space character to stop errors
+	else if (uniCode < 32) return 1;
+
+	int32_t cwidth  = 0;
+	int32_t cheight = 0;
+
+	if (textfont == 1) {
+#ifdef LOAD_GLCD
+		cwidth  = 6;
+		cheight = 8;
+#else
+		return 1;
+#endif
+	}
+	else if ((textfont > 1) && (textfont < 9)) {
+		if (uniCode > 127) return 1;
+		cwidth  = pgm_read_byte( (const uint8_t *)pgm_read_ptr( &(fontdata[textfont].widthtbl ) ) + uniCode - 32 );
+		cheight = pgm_read_byte( &fontdata[textfont].height );
+		if (textfont == 2) cwidth = (cwidth + 6) / 8 * 8; // Font 2 is rendered in whole bytes
+	}
+
+	cheight = cheight * textsize;
+
+	if (utf8 == '\n') {
+		cursor_y += cheight;
+		cursor_x  = 0;
+	}
+	else {
+		if (textwrapX && (cursor_x + cwidth * textsize > width())) {
+			cursor_y += cheight;
+			cursor_x = 0;
+		}
+		if (textwrapY && (cursor_y >= (int32_t) height())) cursor_y = 0;
+		cursor_x += drawChar(uniCode, cursor_x, cursor_y, textfont);
+	}
+
+	return 1;
 }
 
 void TFT_eSPI::setCallback(getColorCallback getCol)
@@ -1697,80 +2425,249 @@ uint16_t TFT_eSPI::fontsLoaded()
 	return 0;
 }
 
-uint16_t TFT_eSPI::color565(uint8_t red, uint8_t green, uint8_t blue)
+void TFT_eSPI::startWrite()
 {
-	return 0;
+
 }
 
-uint16_t TFT_eSPI::color8to16(uint8_t color332)
+void TFT_eSPI::writeColor(uint16_t color, uint32_t len)
 {
-	return 0;
+	BUS_PRIMITIVE("writeColor");
+
+	pushBlock(color, len);
 }
 
-uint8_t TFT_eSPI::color16to8(uint16_t color565)
+void TFT_eSPI::endWrite()
 {
-	return 0;
+	// Like releasing chip select on the device, ends the DMA transfer
+	dmaWait();
 }
 
-uint32_t TFT_eSPI::color16to24(uint16_t color565)
+void TFT_eSPI::setAttribute(uint8_t id, uint8_t a)
 {
-	return 0;
+
 }
 
-uint32_t TFT_eSPI::color24to16(uint32_t color888)
+uint8_t TFT_eSPI::getAttribute(uint8_t id)
 {
 	return 0;
 }
 
-uint16_t TFT_eSPI::alphaBlend(uint8_t alpha, uint16_t fgc, uint16_t bgc)
+void TFT_eSPI::getSetup(setup_t &tft_settings)
 {
-	return 0;
+
 }
 
-uint16_t TFT_eSPI::alphaBlend(uint8_t alpha, uint16_t fgc, uint16_t bgc, uint8_t dither)
+bool TFT_eSPI::verifySetupID(uint32_t id)
 {
 	return 0;
 }
 
-void TFT_eSPI::startWrite()
+SPIClass &TFT_eSPI::getSPIinstance()
 {
+	static SPIClass SPI;
+	return SPI;
+}
+
+// Fill a pre-clipped area of the frame buffer, coordinates are in screen space
+void TFT_eSPI::fillFramebuffer(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t color)
+{
+	busWindow();
+	busPixels(w * h);
+	addDamage(x, y, w, h);
+	dmaWait();
 
+	uint16_t *row = _fb + y * _width + x;
+	if (w == 1) {
+		// Column, one strided store per row
+		while (h--) { *row = color; row += _width; }
+		return;
+	}
+	while (h--) {
+		std::fill_n(row, w, color);
+		row += _width;
+	}
 }
 
-void TFT_eSPI::writeColor(uint16_t color, uint32_t len)
+void TFT_eSPI::blendPixels(int32_t x, int32_t y, uint32_t len, const uint16_t *fg, const uint8_t *alpha, uint8_t dither)
 {
+	BUS_PRIMITIVE("blendPixels");
 
+	blendFramebuffer(x, y, len, fg, 0, alpha, dither);
 }
 
-void TFT_eSPI::endWrite()
+void TFT_eSPI::blendColor(int32_t x, int32_t y, uint32_t len, const uint8_t *alpha, uint16_t color, uint8_t dither)
 {
+	BUS_PRIMITIVE("blendColor");
 
+	blendFramebuffer(x, y, len, nullptr, color, alpha, dither);
 }
 
-void TFT_eSPI::setAttribute(uint8_t id, uint8_t a)
+void TFT_eSPI::drawCoverage(int32_t x, int32_t y, uint32_t len, const uint8_t *alpha, uint32_t color, uint32_t bg_color)
+{
+	blendFramebuffer(x, y, len, nullptr, color, alpha, 0, bg_color);
+}
+
+void TFT_eSPI::drawSpans(const fb_span_t *spans, uint32_t count, uint32_t color)
 {
+	if (_vpOoB || !_fb) return;
+
+	dmaWait();
+
+	fb_rect_t area = { _vpW, _vpH, _vpX, _vpY };
+	for (uint32_t i = 0; i < count; i++) {
+		int32_t y = spans[i].y + _yDatum;
+		if ((y < _vpY) || (y >= _vpH)) continue;
 
+		int32_t x0 = std::max(spans[i].x0 + _xDatum, _vpX);
+		int32_t x1 = std::min(spans[i].x1 + _xDatum + 1, _vpW);
+		if (x0 >= x1) continue;
+
+		busWindow();
+		busPixels(x1 - x0);
+		std::fill_n(_fb + y * _width + x0, x1 - x0, (uint16_t)color);
+
+		area.x0 = std::min(area.x0, x0);
+		area.x1 = std::max(area.x1, x1);
+		area.y0 = std::min(area.y0, y);
+		area.y1 = std::max(area.y1, y + 1);
+	}
+
+	if (area.x0 < area.x1) addDamage(area.x0, area.y0, area.x1 - area.x0, area.y1 - area.y0);
 }
 
-uint8_t TFT_eSPI::getAttribute(uint8_t id)
+void TFT_eSPI::pushRow(int32_t x, int32_t y, uint32_t len, const uint16_t *colors)
 {
-	return 0;
+	if (_vpOoB || !_fb) return;
+
+	x+= _xDatum;
+	y+= _yDatum;
+
+	// Clipping
+	if ((y < _vpY) || (y >= _vpH) || (x >= _vpW)) return;
+
+	int64_t w = len;
+	if (x < _vpX) {
+		int32_t dx = _vpX - x;
+		if (w <= dx) return;
+		w -= dx;
+		x = _vpX;
+		colors += dx;
+	}
+
+	if ((x + w) > _vpW) w = _vpW - x;
+
+	busWindow();
+	busPixels(w);
+	dmaWait();
+
+	memcpy(_fb + y * _width + x, colors, w * sizeof(uint16_t));
+	addDamage(x, y, w, 1);
 }
 
-void TFT_eSPI::getSetup(setup_t &tft_settings)
+// Blend a row onto the frame buffer, fg == nullptr blends color. Without a bg_color the row is
+// read back first on the device, so the bus sends it twice.
+void TFT_eSPI::blendFramebuffer(int32_t x, int32_t y, uint32_t len, const uint16_t *fg, uint16_t color, const uint8_t *alpha,
+										  uint8_t dither, uint32_t bg_color)
 {
+	if (_vpOoB || !_fb) return;
+
+	x+= _xDatum;
+	y+= _yDatum;
+
+	// Clipping
+	if ((y < _vpY) || (y >= _vpH) || (x >= _vpW)) return;
+
+	int64_t w = len;
+	if (x < _vpX) {
+		int32_t dx = _vpX - x;
+		if (w <= dx) return;
+		w -= dx;
+		x = _vpX;
+		alpha += dx;
+		if (fg) fg += dx;
+	}
+
+	if ((x + w) > _vpW) w = _vpW - x;
+
+	if (bg_color == 0x00FFFFFF) {
+		busWindow();
+		busRead(w);
+	}
+	busWindow();
+	busPixels(w);
+	dmaWait();
+
+	uint16_t *row = _fb + y * _width + x;
 
+	// Pixels with alpha 0 blend to the colour already there
+	if (bg_color != 0x00FFFFFF) {
+		for (int32_t i = 0; i < w; i++)
+			if (alpha[i]) row[i] = bg_color;
+	}
+
+	if (fg) alphaBlendRow(alpha, fg, row, row, w, dither);
+	else    alphaBlendMask(alpha, color, row, row, w, dither);
+
+	addDamage(x, y, w, 1);
+	autoPresent();
 }
 
-bool TFT_eSPI::verifySetupID(uint32_t id)
+// Record a changed (pre-clipped) frame buffer area so present() only uploads damaged areas.
+// Touching or overlapping areas are merged, when the list is full the new area is merged
+// into the rectangle that grows the least.
+void TFT_eSPI::addDamage(int32_t x, int32_t y, int32_t w, int32_t h)
 {
-	return 0;
+	int32_t x1 = x + w, y1 = y + h;
+
+	// Most writes are inside or next to the area that was damaged last
+	for (uint8_t n = 0; n < _damageCount; n++) {
+		uint8_t i = (_damageLast + n) % _damageCount;
+		fb_rect_t &r = _damage[i];
+		if (x <= r.x1 && x1 >= r.x0 && y <= r.y1 && y1 >= r.y0) {
+			if (x  < r.x0) r.x0 = x;
+			if (y  < r.y0) r.y0 = y;
+			if (x1 > r.x1) r.x1 = x1;
+			if (y1 > r.y1) r.y1 = y1;
+			_damageLast = i;
+			return;
+		}
+	}
+
+	if (_damageCount < TFT_DAMAGE_RECTS) {
+		_damageLast = _damageCount++;
+		_damage[_damageLast] = { x, y, x1, y1 };
+		return;
+	}
+
+	int64_t best = INT64_MAX;
+	for (uint8_t i = 0; i < _damageCount; i++) {
+		const fb_rect_t &r = _damage[i];
+		int64_t grow = (int64_t)(std::max(x1, r.x1) - std::min(x, r.x0)) * (std::max(y1, r.y1) - std::min(y, r.y0))
+						 - (int64_t)(r.x1 - r.x0) * (r.y1 - r.y0);
+		if (grow < best) { best = grow; _damageLast = i; }
+	}
+
+	fb_rect_t &r = _damage[_damageLast];
+	r = { std::min(x, r.x0), std::min(y, r.y0), std::max(x1, r.x1), std::max(y1, r.y1) };
 }
 
-SPIClass &TFT_eSPI::getSPIinstance()
+// Merge damaged areas that have grown into each other, returns the number of areas left
+uint8_t TFT_eSPI::mergeDamage()
 {
-	static SPIClass SPI;
-	return SPI;
+	for (uint8_t i = 0; i < _damageCount; i++) {
+		for (uint8_t j = i + 1; j < _damageCount; j++) {
+			fb_rect_t &a = _damage[i];
+			const fb_rect_t &b = _damage[j];
+			if (a.x0 < b.x1 && a.x1 > b.x0 && a.y0 < b.y1 && a.y1 > b.y0) {
+				a = { std::min(a.x0, b.x0), std::min(a.y0, b.y0), std::max(a.x1, b.x1), std::max(a.y1, b.y1) };
+				_damage[j] = _damage[--_damageCount];
+				j = i; // Restart, a has grown
+			}
+		}
+	}
+	_damageLast = 0;
+	return _damageCount;
 }
 
 void TFT_eSPI::begin_tft_write()
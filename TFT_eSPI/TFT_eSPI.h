@@ -130,6 +130,28 @@
   #define SPI_BUSY_CHECK
 #endif
 
+// Bus cost model, see Extensions/BusCost.h
+// TFT_BUS_BYTE_PS: time to send one byte in picoseconds
+// TFT_BUS_CMD_NS:  extra time of a command byte (DC line switching, transfer set up)
+#if defined (TFT_PARALLEL_8_BIT) || defined (TFT_PARALLEL_16_BIT)
+  #ifndef TFT_WRITE_CYCLE_NS
+	 #define TFT_WRITE_CYCLE_NS 50
+  #endif
+  #ifdef TFT_PARALLEL_16_BIT
+	 #define TFT_BUS_BYTE_PS (TFT_WRITE_CYCLE_NS * 500) // Two bytes per write cycle
+  #else
+	 #define TFT_BUS_BYTE_PS (TFT_WRITE_CYCLE_NS * 1000)
+  #endif
+  #ifndef TFT_BUS_CMD_NS
+	 #define TFT_BUS_CMD_NS 0
+  #endif
+#else
+  #define TFT_BUS_BYTE_PS (8000000000000ULL / SPI_FREQUENCY)
+  #ifndef TFT_BUS_CMD_NS
+	 #define TFT_BUS_CMD_NS 250
+  #endif
+#endif
+
 /***************************************************************************************
 **                         Section 4: Setup fonts
 ***************************************************************************************/
@@ -188,7 +210,9 @@
   // the sketch if they are used
   #include <Fonts/GFXFF/gfxfont.h>
   // Call up any user custom fonts
-  #include <User_Setups/User_Custom_Fonts.h>
+  #if __has_include(<User_Setups/User_Custom_Fonts.h>)
+	 #include <User_Setups/User_Custom_Fonts.h>
+  #endif
 #endif // #ifdef LOAD_GFXFF
 
 // Create a null default font in case some fonts not used (to prevent crash)
@@ -398,6 +422,62 @@ swap_coord(T& a, T& b) { T t = a; a = b; b = t; }
 // Callback prototype for smooth font pixel colour read
 typedef uint16_t (*getColorCallback)(uint16_t x, uint16_t y);
 
+// Frame buffer area, x1 and y1 are exclusive (used for damage tracking)
+typedef struct { int32_t x0, y0, x1, y1; } fb_rect_t;
+
+// Row of pixels x0 to x1 (inclusive) on line y, shapes are drawn as lists of spans
+typedef struct { int32_t x0, x1, y; } fb_span_t;
+
+// Triangle with corners x1,y1 x2,y2 and x3,y3 filled with a 16 bit colour, see fillTriangles()
+typedef struct { int32_t x1, y1, x2, y2, x3, y3; uint32_t color; } tft_triangle_t;
+
+// Maximum number of separate damaged areas uploaded per present
+#ifndef TFT_DAMAGE_RECTS
+  #define TFT_DAMAGE_RECTS 8
+#endif
+
+// Memory used by decoded glyphs of Fonts 2 to 8 before the glyph cache is emptied
+#ifndef TFT_GLYPH_CACHE_BYTES
+  #define TFT_GLYPH_CACHE_BYTES (1024 * 1024)
+#endif
+
+// Memory used by the rendered strings of drawString() before the least recently used are dropped, 0 disables the cache
+#ifndef TFT_TEXT_CACHE_BYTES
+  #define TFT_TEXT_CACHE_BYTES (64 * 1024)
+#endif
+
+// Rotation (0-3) the panel is mounted in, the window shows the panel this way up
+#ifndef TFT_MOUNT_ROTATION
+  #define TFT_MOUNT_ROTATION 0
+#endif
+
+// Number of primitives and call sites the bus cost is reported for
+#ifndef TFT_BUS_ENTRIES
+  #define TFT_BUS_ENTRIES 32
+#endif
+
+// DMA transfer statistics
+typedef struct {
+  uint32_t transfers;  // Transfers started
+  uint32_t races;      // Transfers whose source buffer was modified before they were over
+  uint64_t busTime;    // Bus time of all transfers (us)
+  uint64_t waitTime;   // Time the sketch waited for transfers (us), the rest overlapped with drawing
+} dma_stats_t;
+
+// Text run cache statistics
+typedef struct {
+  uint32_t hits;       // Strings drawn from the cache
+  uint32_t misses;     // Strings rendered and added to the cache
+  uint32_t runs;       // Strings in the cache
+  uint32_t bytes;      // Memory used, at most TFT_TEXT_CACHE_BYTES
+} text_cache_stats_t;
+
+// SDL window presenter, see Extensions/Presenter.h
+class TFT_ePresenter;
+
+// DMA engine emulation, see Extensions/DMA.h
+class TFT_eDMA;
+
 // Class functions and variables
 class TFT_eSPI : public Print { friend class TFT_eSprite; // Sprite class has access to protected members
 
@@ -412,6 +492,18 @@ class TFT_eSPI : public Print { friend class TFT_eSprite; // Sprite class has ac
   void     init(uint8_t tc = TAB_COLOUR), begin(uint8_t tc = TAB_COLOUR);
   void loop();
 
+  // Presentation policy of the frame buffer to the SDL window, the default is PRESENT_ON_LOOP
+  // PRESENT_ON_LOOP: show the frame each time the sketch loop() returns
+  // PRESENT_MAX_FPS: show the frame while drawing, but not more often than fps times per second
+  // PRESENT_MANUAL:  show the frame only when the sketch calls present()
+			  #define PRESENT_ON_LOOP 0
+			  #define PRESENT_MAX_FPS 1
+			  #define PRESENT_MANUAL  2
+  void     setPresentMode(uint8_t mode, uint16_t fps = 60);
+  uint8_t  getPresentMode(void);
+  void     present(void);          // Show the frame buffer now
+  bool     isHeadless(void);       // True if the display has no window (TFT_HEADLESS or TFT_ESPI_HEADLESS=1)
+
   // These are virtual so the TFT_eSprite class can override them with sprite specific functions
   virtual void     drawPixel(int32_t x, int32_t y, uint32_t color),
 						 drawChar(int32_t x, int32_t y, uint16_t c, uint32_t color, uint32_t bg, uint8_t size),
@@ -488,8 +580,10 @@ class TFT_eSPI : public Print { friend class TFT_eSprite; // Sprite class has ac
 			  drawRoundRect(int32_t x, int32_t y, int32_t w, int32_t h, int32_t radius, uint32_t color),
 			  fillRoundRect(int32_t x, int32_t y, int32_t w, int32_t h, int32_t radius, uint32_t color);
 
-  void     fillRectVGradient(int16_t x, int16_t y, int16_t w, int16_t h, uint32_t color1, uint32_t color2);
-  void     fillRectHGradient(int16_t x, int16_t y, int16_t w, int16_t h, uint32_t color1, uint32_t color2);
+			  // Fill a rectangle with a gradient from color1 at the top (left) to color2 at the bottom (right)
+			  // Dither spreads the colours with a 4 x 4 ordered pattern, hiding the bands of 565 colours
+  void     fillRectVGradient(int16_t x, int16_t y, int16_t w, int16_t h, uint32_t color1, uint32_t color2, bool dither = false);
+  void     fillRectHGradient(int16_t x, int16_t y, int16_t w, int16_t h, uint32_t color1, uint32_t color2, bool dither = false);
 
 			  // Draw a pixel blended with the pixel colour on the TFT or sprite, return blended colour
 			  // If bg_color is not included the background pixel colour will be read from TFT or sprite
@@ -525,6 +619,9 @@ class TFT_eSPI : public Print { friend class TFT_eSprite; // Sprite class has ac
 			  drawTriangle(int32_t x1,int32_t y1, int32_t x2,int32_t y2, int32_t x3,int32_t y3, uint32_t color),
 			  fillTriangle(int32_t x1,int32_t y1, int32_t x2,int32_t y2, int32_t x3,int32_t y3, uint32_t color);
 
+			  // Fill count triangles, e.g. the faces of a mesh, in one call
+  void     fillTriangles(const tft_triangle_t *triangles, uint32_t count);
+
   // Image rendering
 			  // Swap the byte order for pushImage() and pushPixels() - corrects endianness
   void     setSwapBytes(bool swap);
@@ -623,6 +720,14 @@ class TFT_eSPI : public Print { friend class TFT_eSprite; // Sprite class has ac
 			  fontHeight(int16_t font),                        // Returns pixel height of string in specified font
 			  fontHeight(void);                                // Returns pixel width of string in current font
 
+			  // Glyphs of Fonts 2 to 8 are decoded once per text size, free the decoded glyphs
+  void     clearGlyphCache(void);
+
+			  // drawString() keeps the strings it renders, a repeated string is drawn from its spans
+  text_cache_stats_t getTextCacheStats(void);
+  void     resetTextCacheStats(void),                      // Zero the hit and miss counters
+			  clearTextCache(void);                           // Free the cached strings
+
 			  // Used by library and Smooth font class to extract Unicode point codes from a UTF8 encoded string
   uint16_t decodeUTF8(uint8_t *buf, uint16_t *index, uint16_t remaining),
 			  decodeUTF8(uint8_t c);
@@ -656,16 +761,35 @@ class TFT_eSPI : public Print { friend class TFT_eSprite; // Sprite class has ac
 
   // Colour conversion
 			  // Convert 8 bit red, green and blue to 16 bits
-  uint16_t color565(uint8_t red, uint8_t green, uint8_t blue);
+  static constexpr uint16_t color565(uint8_t red, uint8_t green, uint8_t blue)
+  { return ((red & 0xF8) << 8) | ((green & 0xFC) << 3) | (blue >> 3); }
 
-			  // Convert 8 bit colour to 16 bits
-  uint16_t color8to16(uint8_t color332);
+			  // Convert 8 bit colour to 16 bits, the 2 blue bits map to 0, 11, 21 and 31
+  static constexpr uint16_t color8to16(uint8_t color332)
+  { return (color332 & 0xE0) << 8 | (color332 & 0xC0) << 5 | (color332 & 0x1C) << 6 | (color332 & 0x1C) << 3
+			  | ((color332 & 0x03) * 10 + ((color332 & 0x03) != 0)); }
 			  // Convert 16 bit colour to 8 bits
-  uint8_t  color16to8(uint16_t color565);
+  static constexpr uint8_t  color16to8(uint16_t color565)
+  { return ((color565 & 0xE000) >> 8) | ((color565 & 0x0700) >> 6) | ((color565 & 0x0018) >> 3); }
 
 			  // Convert 16 bit colour to/from 24 bit, R+G+B concatenated into LS 24 bits
-  uint32_t color16to24(uint16_t color565);
-  uint32_t color24to16(uint32_t color888);
+  static constexpr uint32_t color16to24(uint16_t color565)
+  { return (uint32_t)(((color565 >> 8) & 0xF8) | (color565 >> 13)) << 16
+			| (uint32_t)(((color565 >> 3) & 0xFC) | ((color565 >> 9) & 0x03)) << 8
+			| (uint32_t)(((color565 << 3) & 0xF8) | ((color565 >> 2) & 0x07)); }
+  static constexpr uint32_t color24to16(uint32_t color888)
+  { return ((color888 >> 8) & 0xF800) | ((color888 >> 5) & 0x07E0) | ((color888 >> 3) & 0x001F); }
+
+			  // Convert buffers of len pixels, using SSE2 or AVX2 kernels where the CPU has them
+			  // swap writes (or swapped reads) 16 bit colours in TFT byte order, high byte first
+			  // RGB888 is 3 bytes per pixel in R, G, B order, RGB666 as used by 18 bit TFTs is the same
+			  // with the low 2 bits of each byte ignored
+  static void color888to565(const uint8_t *rgb, uint16_t *color, uint32_t len, bool swap = false);
+  static void color565to888(const uint16_t *color, uint8_t *rgb, uint32_t len);
+  static void color332to565(const uint8_t *color332, uint16_t *color, uint32_t len, bool swap = false);
+  static void color565to332(const uint16_t *color, uint8_t *color332, uint32_t len, bool swapped = false);
+			  // Swap the bytes of 16 bit colours, in and out may be the same buffer
+  static void swap565(const uint16_t *in, uint16_t *out, uint32_t len);
 
 			  // Alpha blend 2 colours, see generic "alphaBlend_Test" example
 			  // alpha =   0 = 100% background colour
@@ -676,8 +800,17 @@ class TFT_eSPI : public Print { friend class TFT_eSprite; // Sprite class has ac
 			  // 24 bit colour alphaBlend with optional alpha dither
   uint32_t alphaBlend24(uint8_t alpha, uint32_t fgc, uint32_t bgc, uint8_t dither = 0);
 
+			  // Alpha blend len pixels of fg (or one colour fgc with a coverage mask) onto bg, out may be bg
+			  // The results match alphaBlend(), dither only varies alpha values other than 0 and 255
+  static void alphaBlendRow(const uint8_t *alpha, const uint16_t *fg, const uint16_t *bg, uint16_t *out, uint32_t len, uint8_t dither = 0);
+  static void alphaBlendMask(const uint8_t *alpha, uint16_t fgc, const uint16_t *bg, uint16_t *out, uint32_t len, uint8_t dither = 0);
+
+			  // Alpha blend a row of len pixels onto the screen at x,y, reading back the pixels under it
+			  // blendPixels() blends 16 bit colours fg, blendColor() one colour through a coverage mask
+  void     blendPixels(int32_t x, int32_t y, uint32_t len, const uint16_t *fg, const uint8_t *alpha, uint8_t dither = 0);
+  void     blendColor(int32_t x, int32_t y, uint32_t len, const uint8_t *alpha, uint16_t color, uint8_t dither = 0);
+
 
-#ifndef _MSC_VER
   // DMA support functions - these are currently just for SPI writes when using the ESP32 or STM32 processors
 			  // Bear in mind DMA will only be of benefit in particular circumstances and can be tricky
 			  // to manage by noobs. The functions have however been designed to be noob friendly and
@@ -716,10 +849,9 @@ class TFT_eSPI : public Print { friend class TFT_eSprite; // Sprite class has ac
 			  // in progress, this simplifies the sketch and helps avoid "gotchas".
   void     pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t* data, uint16_t* buffer = nullptr);
 
-#if defined (ESP32) // ESP32 only at the moment
 			  // For case where pointer is a const and the image data must not be modified (clipped or byte swapped)
   void     pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t const* data);
-#endif
+
 			  // Push a block of pixels into a window set up using setAddrWindow()
   void     pushPixelsDMA(uint16_t* image, uint32_t len);
 
@@ -727,9 +859,12 @@ class TFT_eSPI : public Print { friend class TFT_eSprite; // Sprite class has ac
   bool     dmaBusy(void); // returns true if DMA is still in progress
   void     dmaWait(void); // wait until DMA is complete
 
+			  // Host only: transfers, source buffer races and time spent waiting, see Extensions/DMA.h
+  dma_stats_t getDMAStats(void);
+  void     resetDMAStats(void);
+
   bool     DMA_Enabled = false;   // Flag for DMA enabled state
   uint8_t  spiBusyCheck = 0;      // Number of ESP32 transfer buffers to check
-#endif
 
   // Bare metal functions
   void     startWrite(void);                         // Begin SPI transaction
@@ -819,8 +954,57 @@ class TFT_eSPI : public Print { friend class TFT_eSprite; // Sprite class has ac
 	 inline void end_tft_read();
 #endif
 
-			  // Helper function: calculate distance of a point from a finite length line between two points
-  float    wedgeLineDistance(float pax, float pay, float bax, float bay, float dr);
+			  // Spans of a circle, ellipse or rounded rectangle: quarters of the conic with radii rx, ry
+			  // around the corners of the box cx0,cy0 to cx1,cy1. quarters is a bit mask of 1 top left,
+			  // 2 top right, 4 bottom right and 8 bottom left, middle includes the rows of the box.
+			  // Filled conics need both quarters of a half.
+  void     drawConic(int32_t cx0, int32_t cy0, int32_t cx1, int32_t cy1, int32_t rx, int32_t ry,
+                     uint8_t quarters, bool middle, bool fill, uint32_t color);
+
+			  // Draw a character of the GLCD font (Font 1) as spans, opaque if bg != color
+  void     drawGLCDChar(int32_t x, int32_t y, uint16_t c, uint32_t color, uint32_t bg, uint8_t size);
+
+#ifdef LOAD_GFXFF
+			  // Draw a character of the free font from its span atlas (see Extensions/GlyphCache.cpp)
+  void     drawFreeFontChar(int32_t x, int32_t y, uint16_t c, uint32_t color, uint8_t size);
+#endif
+
+			  // Draw a character of Fonts 2 to 8 from the glyph cache (see Extensions/GlyphCache.cpp)
+  int16_t  drawCachedChar(uint16_t uniCode, int32_t x, int32_t y, uint8_t font);
+
+			  // drawString() from the text run cache (see Extensions/GlyphCache.cpp), renderString() without it
+  int16_t  drawTextRun(const char *string, int32_t x, int32_t y, uint8_t font),
+			  renderString(const char *string, int32_t x, int32_t y, uint8_t font);
+
+			  // Text spans and rectangles, recorded instead of drawn while a string is added to the text run cache
+  struct   text_record_t;
+  text_record_t *_textRecord;
+  void     textSpans(const fb_span_t *spans, uint32_t count, uint32_t color);
+  void     textRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color);
+
+			  // Add the spans of a triangle to spans, drawSpans() is called when count reaches 64
+  void     triangleSpans(const tft_triangle_t &t, fb_span_t *spans, uint32_t &count);
+
+			  // Anti-aliased fill of a convex shape (see Extensions/AntiAlias.cpp) with solid interior spans
+  template <typename T> void fillSmoothShape(const T &shape, uint32_t color, uint32_t bg_color);
+
+			  // Frame buffer helpers: fill a clipped area and present if the PRESENT_MAX_FPS interval has elapsed
+  void     fillFramebuffer(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t color);
+  void     blendFramebuffer(int32_t x, int32_t y, uint32_t len, const uint16_t *fg, uint16_t color, const uint8_t *alpha,
+                            uint8_t dither, uint32_t bg_color = 0x00FFFFFF);
+  void     autoPresent(void);
+  void     submitFrame(void);      // Hand the damaged areas to the presenter
+
+			  // Write pixels at the address window cursor, data == nullptr writes len pixels of color
+  void     writeWindow(const uint16_t *data, uint16_t color, uint32_t len, bool swap);
+  fb_rect_t advanceWindow(uint32_t len); // Move the cursor, returns the area written on screen
+  static void writeRows(uint16_t *fb, int32_t width, int32_t height, fb_rect_t win, int32_t x, int32_t y,
+                        const uint16_t *data, uint16_t color, uint32_t len, bool swap);
+  void     dmaTransfer(const uint16_t *data, uint32_t len); // Start a DMA transfer to the address window
+
+			  // Damage tracking of changed frame buffer areas for present()
+  void     addDamage(int32_t x, int32_t y, int32_t w, int32_t h);
+  uint8_t  mergeDamage(void);
 
 			  // Display variant settings
   uint8_t  tabcolor,                   // ST7735 screen protector "tab" colour (now invalid)
@@ -848,7 +1032,16 @@ class TFT_eSPI : public Print { friend class TFT_eSprite; // Sprite class has ac
  //-------------------------------------- protected ----------------------------------//
  protected:
 
-  //int32_t  win_xe, win_ye;          // Window end coords - not needed
+						 // Blend color onto a row of len pixels with the coverage in alpha, pixels with alpha 0 are
+						 // left alone. If bg_color is 0x00FFFFFF the background pixel colours are read
+  virtual void     drawCoverage(int32_t x, int32_t y, uint32_t len, const uint8_t *alpha, uint32_t color, uint32_t bg_color);
+						 // Write a row of len 16 bit colours
+  virtual void     pushRow(int32_t x, int32_t y, uint32_t len, const uint16_t *colors);
+						 // Fill count spans with color, the spans are clipped to the viewport
+  virtual void     drawSpans(const fb_span_t *spans, uint32_t count, uint32_t color);
+
+  int32_t  win_xs, win_ys, win_xe, win_ye; // Address window set by setWindow(), not clipped
+  int32_t  win_x, win_y;              // Write cursor in the address window
 
   int32_t  _init_width, _init_height; // Display w/h as input, used by setRotation()
   int32_t  _width, _height;           // Display w/h as modified by current rotation
@@ -890,6 +1083,20 @@ class TFT_eSPI : public Print { friend class TFT_eSprite; // Sprite class has ac
 
   bool     _fillbg;    // Fill background flag (just for for smooth fonts at the moment)
 
+  uint16_t *_fb;       // RGB565 frame buffer all drawing goes to, nullptr until init() (and for Sprites)
+  bool     _headless;  // No SDL window, the frame buffer is only kept in memory
+  bool     _invert;    // Colours are inverted when the frame buffer is shown
+  TFT_ePresenter *_presenter; // Shows submitted frames in the SDL window on its own thread
+  TFT_eDMA *_dma;      // DMA engine created by initDMA()
+  dma_stats_t _dmaStats;
+
+  fb_rect_t _damage[TFT_DAMAGE_RECTS]; // Frame buffer areas changed since the last present
+  uint8_t  _damageCount, _damageLast;  // Number of areas and the area grown last
+
+  uint8_t  _presentMode;      // PRESENT_ON_LOOP, PRESENT_MAX_FPS or PRESENT_MANUAL
+  uint32_t _presentInterval;  // Minimum time between two presents in PRESENT_MAX_FPS mode (us)
+  uint64_t _lastPresent;      // Time of the last present (us)
+
 #if defined (SSD1963_DRIVER)
   uint16_t Cswap;      // Swap buffer for SSD1963
   uint8_t r6, g6, b6;  // RGB buffer for SSD1963
@@ -917,6 +1124,9 @@ class TFT_eSPI : public Print { friend class TFT_eSprite; // Sprite class has ac
 	 #endif
 #endif
 
+// Load the bus cost model
+#include "Extensions/BusCost.h"
+
 // Load the Anti-aliased font extension
 #ifdef SMOOTH_FONT
   #include "Extensions/Smooth_font.h"  // Loaded if SMOOTH_FONT is defined by user
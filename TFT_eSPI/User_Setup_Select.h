@@ -22,8 +22,11 @@
 #ifndef USER_SETUP_SELECT_H
 #define USER_SETUP_SELECT_H
 
-#define TFT_WIDTH 320
-#define TFT_HEIGHT 240
+#define TFT_WIDTH 240
+#define TFT_HEIGHT 320
+
+// The example sketch runs in landscape (rotation 1), show the window that way up
+#define TFT_MOUNT_ROTATION 1
 
 #define DISABLE_ALL_LIBRARY_WARNINGS
 
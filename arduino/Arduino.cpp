@@ -2,7 +2,14 @@
 
 #include <stdlib.h>
 #include <time.h>
+#include <atomic>
 #include <chrono>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <utility>
+#include <vector>
 
 SerialClass Serial = SerialClass();
 
@@ -51,7 +58,50 @@ long map(long x, long in_min, long in_max, long out_min, long out_max)
 	return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
 }
 
-static std::chrono::time_point<std::chrono::steady_clock> _arduino_timer_start;
+static std::atomic<std::chrono::steady_clock::time_point> _arduino_timer_start;
+
+// Clock state, CLOCK_WALL time is _arduino_clock_base + speed * (now - _arduino_timer_start)
+// The clock is read and waited on from the sketch, DMA and bus throttle threads
+static std::atomic<uint8_t> _arduino_clock_mode(CLOCK_WALL);
+static std::atomic<float> _arduino_clock_speed(1.0f);
+static std::atomic<uint64_t> _arduino_clock_base(0);
+static std::atomic<uint64_t> _arduino_clock_virtual(0);
+static std::atomic<clockSource> _arduino_clock_source(nullptr);
+
+// Deadlines registered by polling sketches, earliest first, and the step of a polling loop()
+static std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t>> _arduino_clock_deadlines;
+static std::mutex _arduino_clock_deadline_lock;
+static std::atomic<uint32_t> _arduino_clock_step(0);
+
+// What the sketch did with the clock during the current loop()
+static std::atomic<bool> _arduino_clock_waited(false);
+static std::atomic<bool> _arduino_clock_polled_us(false);
+static std::vector<std::pair<loopEndCallback, void*>> _arduino_loop_end;
+// Displays attach from the thread that initialises them, a callback may detach itself
+static std::recursive_mutex _arduino_loop_end_lock;
+
+void attachLoopEndCallback(loopEndCallback callback, void *arg)
+{
+	std::lock_guard<std::recursive_mutex> lock(_arduino_loop_end_lock);
+	_arduino_loop_end.emplace_back(callback, arg);
+}
+
+void detachLoopEndCallback(loopEndCallback callback, void *arg)
+{
+	std::lock_guard<std::recursive_mutex> lock(_arduino_loop_end_lock);
+	auto it = std::find(_arduino_loop_end.begin(), _arduino_loop_end.end(), std::make_pair(callback, arg));
+	if (it != _arduino_loop_end.end())
+		_arduino_loop_end.erase(it);
+}
+
+// Earliest deadline after now, 0 if none, the deadlines that have passed are dropped
+static uint64_t nextDeadline(uint64_t now)
+{
+	std::lock_guard<std::mutex> lock(_arduino_clock_deadline_lock);
+	while (!_arduino_clock_deadlines.empty() && _arduino_clock_deadlines.top() <= now)
+		_arduino_clock_deadlines.pop();
+	return _arduino_clock_deadlines.empty() ? 0 : _arduino_clock_deadlines.top();
+}
 
 int main(int argv, char **argc)
 {
@@ -61,7 +111,26 @@ int main(int argv, char **argc)
 
 	try {
 		while(true) {
+			_arduino_clock_waited = false;
+			_arduino_clock_polled_us = false;
+
 			loop();
+			{
+				std::lock_guard<std::recursive_mutex> lock(_arduino_loop_end_lock);
+				for (size_t i = 0; i < _arduino_loop_end.size(); ++i)
+					_arduino_loop_end[i].first(_arduino_loop_end[i].second);
+			}
+
+			// A loop that did not wait is polling the time, skip to the next time it can change
+			if (_arduino_clock_mode == CLOCK_VIRTUAL && !_arduino_clock_source && !_arduino_clock_waited) {
+				uint64_t now = _arduino_clock_virtual.load();
+				uint64_t next = nextDeadline(now);
+				if (!next) {
+					uint64_t step = _arduino_clock_step ? _arduino_clock_step.load() : _arduino_clock_polled_us ? 1 : 1000;
+					next = now - now % step + step;
+				}
+				clockWaitUntil(next);
+			}
 		}
 	} catch (const std::exception &e) {
 		std::cerr << e.what() << '\n';
@@ -77,6 +146,91 @@ void yield()
 
 unsigned long millis()
 {
-	auto end = std::chrono::steady_clock::now();
-	return std::chrono::duration_cast<std::chrono::microseconds>(end - _arduino_timer_start).count();
+	return (unsigned long)(clockMicros() / 1000);
+}
+
+unsigned long micros()
+{
+	_arduino_clock_polled_us = true;
+	return (unsigned long)clockMicros();
+}
+
+void delay(unsigned long ms)
+{
+	clockWaitUntil(clockMicros() + (uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+	clockWaitUntil(clockMicros() + us);
+}
+
+static uint64_t wallMicros()
+{
+	auto now = std::chrono::steady_clock::now() - _arduino_timer_start.load();
+	return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+}
+
+void setClockMode(uint8_t mode, float speed)
+{
+	// Continue from the current time
+	uint64_t now = clockMicros();
+	_arduino_timer_start = std::chrono::steady_clock::now();
+	_arduino_clock_base = now;
+	_arduino_clock_virtual.store(now);
+
+	_arduino_clock_mode = mode;
+	if (speed > 0) _arduino_clock_speed = speed;
+}
+
+uint8_t getClockMode()
+{
+	return _arduino_clock_mode;
+}
+
+void setClockSource(clockSource source)
+{
+	_arduino_clock_source = source;
+}
+
+uint64_t clockMicros()
+{
+	clockSource source = _arduino_clock_source;
+	if (source)
+		return source();
+	if (_arduino_clock_mode == CLOCK_VIRTUAL)
+		return _arduino_clock_virtual.load();
+	return _arduino_clock_base + (uint64_t)(wallMicros() * (double)_arduino_clock_speed);
+}
+
+void clockDeadline(uint64_t us)
+{
+	std::lock_guard<std::mutex> lock(_arduino_clock_deadline_lock);
+	_arduino_clock_deadlines.push(us);
+}
+
+void setClockStep(uint32_t us)
+{
+	_arduino_clock_step = us;
+}
+
+void clockWaitUntil(uint64_t us)
+{
+	_arduino_clock_waited = true;
+
+	clockSource source = _arduino_clock_source;
+	if (source) {
+		// Nothing is known about the source, poll it
+		while (source() < us) std::this_thread::yield();
+	}
+	else if (_arduino_clock_mode == CLOCK_VIRTUAL) {
+		// Never go back in time if several threads wait
+		uint64_t now = _arduino_clock_virtual.load();
+		while (now < us && !_arduino_clock_virtual.compare_exchange_weak(now, us));
+	}
+	else {
+		uint64_t now = clockMicros();
+		if (us > now)
+			std::this_thread::sleep_for(std::chrono::microseconds((uint64_t)((us - now) / (double)_arduino_clock_speed)));
+	}
 }
@@ -4,6 +4,7 @@
 //#define _CRT_SECURE_DEPRECATE_MEMORY
 #include <string.h>
 #include <stdint.h>
+#include <math.h>
 #include <iostream>
 #include <string>
 #include <algorithm>
@@ -20,7 +21,8 @@
 
 #define pgm_read_byte(addr) (*(const uint8_t *)(addr))
 #define pgm_read_word(addr) (*(const uint16_t *)(addr))
-#define pgm_read_dword(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define pgm_read_ptr(addr) (*(const void * const *)(addr))
 
 class SerialClass : public Stream
 {
@@ -50,6 +52,37 @@ long map(long, long, long, long, long);
 // other
 void yield();
 unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// Time source of millis(), micros(), delay() and delayMicroseconds()
+// CLOCK_WALL:    steady clock, running speed times faster than real time
+// CLOCK_VIRTUAL: time passes only in delay(), and when loop() only polled the time it
+//                jumps to the next deadline, or else the next millisecond (microsecond if
+//                micros() was read)
+#define CLOCK_WALL    0
+#define CLOCK_VIRTUAL 1
+void setClockMode(uint8_t mode, float speed = 1.0f);
+uint8_t getClockMode();
+
+// Replace the time source by a function returning microseconds, nullptr restores the clock
+typedef uint64_t (*clockSource)(void);
+void setClockSource(clockSource source);
+
+// Current time in microseconds and wait until a time, for delay() and display drivers
+uint64_t clockMicros();
+void clockWaitUntil(uint64_t us);
+
+// A time in microseconds a polling sketch waits for (e.g. its millis() target), a polling
+// loop() of CLOCK_VIRTUAL jumps there. Without deadlines it steps by us, 0 for the default
+void clockDeadline(uint64_t us);
+void setClockStep(uint32_t us);
+
+// Functions called by main() each time the sketch loop() returns (used by display drivers)
+typedef void (*loopEndCallback)(void *arg);
+void attachLoopEndCallback(loopEndCallback callback, void *arg);
+void detachLoopEndCallback(loopEndCallback callback, void *arg);
 
 extern void setup();
 extern void loop();
@@ -37,7 +37,7 @@ int Stream::timedRead()
 		if(c >= 0) {
 			return c;
 		}
-	} while(duration_cast<microseconds>(steady_clock::now()-timer).count() < _timeout);
+	} while(duration_cast<milliseconds>(steady_clock::now()-timer).count() < _timeout);
 	return -1;     // -1 indicates timeout
 }
 
@@ -52,7 +52,7 @@ int Stream::timedPeek()
 		if(c >= 0) {
 			return c;
 		}
-	} while(duration_cast<microseconds>(steady_clock::now()-timer).count() < _timeout);
+	} while(duration_cast<milliseconds>(steady_clock::now()-timer).count() < _timeout);
 	return -1;     // -1 indicates timeout
 }
 
@@ -350,7 +350,7 @@ unsigned char String::concat(long num) {
 
 unsigned char String::concat(unsigned long num) {
 	char buf[1 + 3 * sizeof(unsigned long)];
-	_ultoa_s(num, buf, 10);
+	sprintf(buf, "%lu", num);
 	return concat(buf, strlen(buf));
 }
 